@@ -6,18 +6,117 @@
 
 #include "archive.h"
 #include "main.h"
+#include "mem.h"
 
-#ifdef PSXF_PC
+//Archive formats, see funkinarcpak
+//Version 1 is just a directory of name and position, version 2 starts with a header and gives each entry a size and flags
+#define ARCHIVE_V2_HEAD_SIZE 32
+#define ARCHIVE_V2_ENT_SIZE  32
+
+#define ARCHIVE_FLAG_SECTOR (1 << 0) //Entry starts on a sector
+
+//Archive hash index
+//The directory is in slot order, version 1 puts a footer right before the first file and version 2 has it in the header
+static u32 Archive_Get32(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static u32 Archive_Hash(const char *path)
+{
+	//Must match ARCHIVE_HASH
+	u32 hash = 0x811C9DC5U;
+	for (int i = 0; i < 12; i++)
+	{
+		hash = (hash ^ (u8)*path) * 0x01000193U;
+		if (*path != '\0')
+			path++;
+	}
+	return hash;
+}
+
+static u32 Archive_Slot(u32 hash, u16 disp, u32 files)
+{
+	//Mix displacement into the hash
+	hash ^= disp * 0x9E3779B9U;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6BU;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35U;
+	hash ^= hash >> 16;
+	return hash % files;
+}
+
+static boolean Archive_IsV2(const u8 *arcp)
+{
+	return arcp[0] == 'F' && arcp[1] == 'A' && arcp[2] == 'R' && arcp[3] == 'C' && Archive_Get32(arcp + 4) == 2;
+}
+
+static const u8 *Archive_Lookup(IO_Data arc, const char *path, u32 hash)
+{
+	//Get directory layout and hash index
+	const u8 *arcp = (const u8*)arc;
+	const u8 *dir, *disp = NULL;
+	u32 stride, files = 0xFFFFFFFF, buckets = 0;
+	if (Archive_IsV2(arcp))
+	{
+		dir = arcp + ARCHIVE_V2_HEAD_SIZE;
+		stride = ARCHIVE_V2_ENT_SIZE;
+		files = Archive_Get32(arcp + 8);
+		if (Archive_Get32(arcp + 16) != 0)
+		{
+			disp = arcp + Archive_Get32(arcp + 16);
+			buckets = Archive_Get32(arcp + 20);
+		}
+	}
+	else
+	{
+		dir = arcp;
+		stride = 16;
+		u32 first = Archive_Get32(arcp + 12);
+		const u8 *footer = arcp + first - 16;
+		if (first >= 16 && footer[0] == '\0' && footer[1] == 'M' && footer[2] == 'P' && footer[3] == 'H')
+		{
+			files = Archive_Get32(footer + 4);
+			disp = arcp + Archive_Get32(footer + 8);
+			buckets = Archive_Get32(footer + 12);
+		}
+	}
+	
+	//Probe the hash index if the archive has one
+	if (disp != NULL && files != 0 && buckets != 0)
+	{
+		disp += (hash % buckets) * 2;
+		const u8 *entry = dir + Archive_Slot(hash, disp[0] | (disp[1] << 8), files) * stride;
+		return (strncmp((const char*)entry, path, 12) == 0) ? entry : NULL;
+	}
+	
+	//Check against all archive files
+	for (; files-- != 0 && *dir != '\0'; dir += stride)
+		if (strncmp((const char*)dir, path, 12) == 0)
+			return dir;
+	return NULL;
+}
 
 //Archive functions
 IO_Data Archive_Find(IO_Data arc, const char *path)
 {
-	//Check against all archive files
-	for (u8 *arcp = (u8*)arc; *arcp != '\0'; arcp += 16)
+	return Archive_FindHash(arc, path, Archive_Hash(path));
+}
+
+IO_Data Archive_FindHash(IO_Data arc, const char *path, u32 hash)
+{
+	#ifdef PSXF_PC
+		double stats_start = IO_StatsTime();
+	#endif
+	
+	const u8 *entry = Archive_Lookup(arc, path, hash);
+	if (entry != NULL)
 	{
-		if (strncmp((const char*)arcp, path, 12))
-			continue;
-		return (IO_Data)((u8*)arc + (arcp[12] | (arcp[13] << 8) | (arcp[14] << 16) | (arcp[15] << 24)));
+		#ifdef PSXF_PC
+			IO_StatsFind(stats_start);
+		#endif
+		return (IO_Data)((u8*)arc + Archive_Get32(entry + 12));
 	}
 	
 	//Failed to find the requested file
@@ -26,30 +125,59 @@ IO_Data Archive_Find(IO_Data arc, const char *path)
 	return NULL;
 }
 
-#else
+void Archive_Open(Archive *this, const char *path)
+{
+	//Read the first sector, and the rest of the directory if it doesn't fit
+	IO_FindFile(&this->file, path);
+	this->dir = IO_ReadPart(&this->file, 0, IO_SECT_SIZE);
+	
+	const u8 *arcp = (const u8*)this->dir;
+	if (!Archive_IsV2(arcp))
+	{
+		sprintf(error_msg, "[Archive_Open] %s isn't a version 2 archive", path);
+		ErrorLock();
+		return;
+	}
 	
-//Archive structure
-typedef struct
+	u32 dir_size = Archive_Get32(arcp + 12);
+	if (dir_size > IO_SECT_SIZE)
+	{
+		Mem_Free(this->dir);
+		this->dir = IO_ReadPart(&this->file, 0, dir_size);
+	}
+}
+
+void Archive_Close(Archive *this)
 {
-	char path[12];
-	u32 pos;
-} ArchiveFile;
+	Mem_Free(this->dir);
+	this->dir = NULL;
+}
 
-//Archive functions
-IO_Data Archive_Find(IO_Data arc, const char *path)
+static const u8 *Archive_Entry(Archive *this, const char *path)
 {
-	//Check against all archive files
-	for (const ArchiveFile *file = (const ArchiveFile*)arc; file->path[0] != '\0'; file++)
+	//Find entry that can be read on its own
+	const u8 *entry = Archive_Lookup(this->dir, path, Archive_Hash(path));
+	if (entry == NULL || !(Archive_Get32(entry + 20) & ARCHIVE_FLAG_SECTOR))
 	{
-		if (strncmp(file->path, path, 12))
-			continue;
-		return (IO_Data)((u8*)arc + file->pos);
+		sprintf(error_msg, "[Archive_Read] Can't read %s from %p on its own", path, (void*)this->dir);
+		ErrorLock();
+		return NULL;
 	}
-	
-	//Failed to find the requested file
-	sprintf(error_msg, "[Archive_Find] Failed to find %s in %p", path, (void*)arc);
-	ErrorLock();
-	return NULL;
+	return entry;
+}
+
+IO_Data Archive_Read(Archive *this, const char *path)
+{
+	const u8 *entry = Archive_Entry(this, path);
+	if (entry == NULL)
+		return NULL;
+	return IO_ReadPart(&this->file, Archive_Get32(entry + 12), Archive_Get32(entry + 16));
 }
 
-#endif
+IO_Data Archive_AsyncRead(Archive *this, const char *path)
+{
+	const u8 *entry = Archive_Entry(this, path);
+	if (entry == NULL)
+		return NULL;
+	return IO_AsyncReadPart(&this->file, Archive_Get32(entry + 12), Archive_Get32(entry + 16));
+}
@@ -9,7 +9,32 @@
 
 #include "io.h"
 
+//Archive name hash, FNV-1a of the name padded to 12 bytes
+//ARCHIVE_HASH folds a string literal at compile time, it must not be given a pointer
+#define ARCHIVE_HASH_C(s, i) (((i) < sizeof(s) - 1) ? (u32)(u8)(s)[((i) < sizeof(s) - 1) ? (i) : 0] : 0)
+#define ARCHIVE_HASH_STEP(h, s, i) (((h) ^ ARCHIVE_HASH_C(s, i)) * 0x01000193U)
+#define ARCHIVE_HASH(s) \
+	ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP( \
+	ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP( \
+	ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP(ARCHIVE_HASH_STEP( \
+	0x811C9DC5U, s, 0), s, 1), s, 2), s, 3), s, 4), s, 5), s, 6), s, 7), s, 8), s, 9), s, 10), s, 11)
+
+//Archive types
+typedef struct
+{
+	CdlFILE file;
+	IO_Data dir; //Header and directory, entries are read as they're needed
+} Archive;
+
 //Archive functions
 IO_Data Archive_Find(IO_Data arc, const char *path);
+IO_Data Archive_FindHash(IO_Data arc, const char *path, u32 hash);
+#define Archive_FindConst(arc, path) Archive_FindHash(arc, path, ARCHIVE_HASH(path))
+
+//Reading single entries, only version 2 archives can be opened
+void Archive_Open(Archive *this, const char *path);
+void Archive_Close(Archive *this);
+IO_Data Archive_Read(Archive *this, const char *path);
+IO_Data Archive_AsyncRead(Archive *this, const char *path);
 
 #endif
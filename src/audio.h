@@ -8,6 +8,7 @@
 #define PSXF_GUARD_AUDIO_H
 
 #include "psx.h"
+#include "fixed.h"
 
 //XA enumerations
 typedef enum
@@ -99,18 +100,38 @@ typedef enum
 	XA_TrackMax,
 } XA_Track;
 
+//Audio statistics
+typedef struct
+{
+	u32 callbacks, late_callbacks;                 //Device callbacks made and ones later than the device buffer lasts
+	u32 callback_us, callback_us_avg, callback_us_max; //Time spent in the device callback
+	u32 period_frames, periods, sample_rate;       //Device buffer layout the backend gave us
+	u32 latency_us;                                //Output latency implied by the device buffer
+} Audio_Stats;
+
 //Audio functions
 void Audio_Init(void);
 void Audio_Quit(void);
 void Audio_PlayXA_Track(XA_Track track, u8 volume, u8 channel, boolean loop);
 void Audio_SeekXA_Track(XA_Track track);
+void Audio_PrefetchXA_Track(XA_Track track);
 void Audio_PauseXA(void);
 void Audio_StopXA(void);
 void Audio_ChannelXA(u8 channel);
+void Audio_SetRateXA(fixed_t rate);
 s32 Audio_TellXA_Sector(void);
 s32 Audio_TellXA_Milli(void);
 boolean Audio_PlayingXA(void);
 void Audio_WaitPlayXA(void);
 void Audio_ProcessXA(void);
+void Audio_GetStats(Audio_Stats *stats);
+s32 Audio_GetLatency(void);
+void Audio_SetLatency(s32 latency);
+
+#ifdef PSXF_PC
+	//Metronome, click times are in glfwGetTime seconds at the point the click was mixed
+	void Audio_PlayClick(u32 interval);
+	u8 Audio_GetClicks(double *times, u8 max);
+#endif
 
 #endif
@@ -66,8 +66,10 @@ typedef struct
 	Character character;
 	
 	//Render data and state
-	IO_Data arc_main, arc_dead;
-	CdlFILE file_dead_arc; //dead.arc file position
+	IO_Data arc_main;
+	Archive arc_dead; //dead.arc directory, its sheets are read one at a time once BF dies
+	IO_Data arc_dead_ptr[BF_ArcDead_Max];
+	u8 arc_dead_read; //dead.arc sheets that have started reading
 	IO_Data arc_ptr[BF_Arc_Max];
 	
 	Gfx_Tex tex, tex_retry;
@@ -152,6 +154,21 @@ static const Animation char_bf_anim[PlayerAnim_Max] = {
 };
 
 //Boyfriend player functions
+static void Char_BF_ReadDead(Char_BF *this)
+{
+	//Start reading the next dead.arc sheet once the last one is in, the drive only reads one at a time
+	static const char *paths[BF_ArcDead_Max] = {
+		"dead1.tim", //BF_ArcDead_Dead1
+		"dead2.tim", //BF_ArcDead_Dead2
+		"retry.tim", //BF_ArcDead_Retry
+	};
+	if (this->arc_dead_read < BF_ArcDead_Max && (this->arc_dead_read == 0 || IO_IsDone(this->arc_dead_ptr[this->arc_dead_read - 1])))
+	{
+		this->arc_dead_ptr[this->arc_dead_read] = Archive_AsyncRead(&this->arc_dead, paths[this->arc_dead_read]);
+		this->arc_dead_read++;
+	}
+}
+
 void Char_BF_SetFrame(void *user, u8 frame)
 {
 	Char_BF *this = (Char_BF*)user;
@@ -220,6 +237,10 @@ void Char_BF_Tick(Character *character)
 		}
 	}
 	
+	//Keep dead.arc coming while BREAK plays
+	if (character->animatable.anim == PlayerAnim_Dead0 || character->animatable.anim == PlayerAnim_Dead1)
+		Char_BF_ReadDead(this);
+	
 	//Retry screen
 	if (character->animatable.anim >= PlayerAnim_Dead3)
 	{
@@ -334,30 +355,31 @@ void Char_BF_SetAnim(Character *character, u8 anim)
 	{
 		case PlayerAnim_Dead0:
 			//Begin reading dead.arc and adjust focus
-			this->arc_dead = IO_AsyncReadFile(&this->file_dead_arc);
+			Char_BF_ReadDead(this);
 			character->focus_x = FIXED_DEC(0,1);
 			character->focus_y = FIXED_DEC(-40,1);
 			character->focus_zoom = FIXED_DEC(125,100);
 			break;
 		case PlayerAnim_Dead2:
+			//Finish reading dead.arc
+			while (this->arc_dead_read < BF_ArcDead_Max)
+			{
+				IO_Wait();
+				Char_BF_ReadDead(this);
+			}
+			IO_Wait();
+			
 			//Unload main.arc
 			Mem_Free(this->arc_main);
-			this->arc_main = this->arc_dead;
-			this->arc_dead = NULL;
+			this->arc_main = NULL;
 			
-			//Find dead.arc files
-			const char **pathp = (const char *[]){
-				"dead1.tim", //BF_ArcDead_Dead1
-				"dead2.tim", //BF_ArcDead_Dead2
-				"retry.tim", //BF_ArcDead_Retry
-				NULL
-			};
-			IO_Data *arc_ptr = this->arc_ptr;
-			for (; *pathp != NULL; pathp++)
-				*arc_ptr++ = Archive_Find(this->arc_main, *pathp);
+			//Use dead.arc sheets
+			this->arc_ptr[BF_ArcDead_Dead1] = this->arc_dead_ptr[BF_ArcDead_Dead1];
+			this->arc_ptr[BF_ArcDead_Dead2] = this->arc_dead_ptr[BF_ArcDead_Dead2];
 			
-			//Load retry art
-			Gfx_LoadTex(&this->tex_retry, this->arc_ptr[BF_ArcDead_Retry], 0);
+			//Load retry art, it's only needed in VRAM
+			Gfx_LoadTex(&this->tex_retry, this->arc_dead_ptr[BF_ArcDead_Retry], GFX_LOADTEX_FREE);
+			this->arc_dead_ptr[BF_ArcDead_Retry] = NULL;
 			break;
 	}
 	
@@ -372,7 +394,9 @@ void Char_BF_Free(Character *character)
 	
 	//Free art
 	Mem_Free(this->arc_main);
-	Mem_Free(this->arc_dead);
+	for (int i = 0; i < BF_ArcDead_Max; i++)
+		Mem_Free(this->arc_dead_ptr[i]);
+	Archive_Close(&this->arc_dead);
 }
 
 Character *Char_BF_New(fixed_t x, fixed_t y)
@@ -405,8 +429,10 @@ Character *Char_BF_New(fixed_t x, fixed_t y)
 	
 	//Load art
 	this->arc_main = IO_Read("\\CHAR\\BF.ARC;1");
-	this->arc_dead = NULL;
-	IO_FindFile(&this->file_dead_arc, "\\CHAR\\BFDEAD.ARC;1");
+	Archive_Open(&this->arc_dead, "\\CHAR\\BFDEAD.ARC;1");
+	for (int i = 0; i < BF_ArcDead_Max; i++)
+		this->arc_dead_ptr[i] = NULL;
+	this->arc_dead_read = 0;
 	
 	const char **pathp = (const char *[]){
 		"bf0.tim",   //BF_ArcMain_BF0
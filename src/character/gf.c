@@ -228,8 +228,13 @@ Character *Char_GF_New(fixed_t x, fixed_t y)
 	this->character.focus_y = FIXED_DEC(-40,1);
 	this->character.focus_zoom = FIXED_DEC(2,1);
 	
-	//Load art
-	this->arc_main = IO_Read("\\CHAR\\GF.ARC;1");
+	//Load art and scene specific art together
+	IO_Data arc_load[2];
+	IO_ReadBatch((const char *[]){
+		"\\CHAR\\GF.ARC;1",
+		(stage.stage_id == StageId_1_4) ? "\\CHAR\\GFTUT.ARC;1" : NULL,
+	}, arc_load, 2);
+	this->arc_main = arc_load[0];
 	
 	const char **pathp = (const char *[]){
 		"gf0.tim", //GF_ArcMain_GF0
@@ -246,7 +251,7 @@ Character *Char_GF_New(fixed_t x, fixed_t y)
 	{
 		case StageId_1_4: //Tutorial
 		{
-			this->arc_scene = IO_Read("\\CHAR\\GFTUT.ARC;1");
+			this->arc_scene = arc_load[1];
 			
 			const char **pathp = (const char *[]){
 				"tut0.tim", //GF_ArcScene_0
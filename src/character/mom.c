@@ -184,11 +184,14 @@ Character *Char_Mom_New(fixed_t x, fixed_t y)
 	this->character.focus_y = FIXED_DEC(-115,1);
 	this->character.focus_zoom = FIXED_DEC(1,1);
 	
-	//Load hair art
-	Gfx_LoadTex(&this->tex_hair, IO_Read("\\CHAR\\MOMHAIR.TIM;1"), GFX_LOADTEX_FREE);
-	
-	//Load art
-	this->arc_main = IO_Read("\\CHAR\\MOM.ARC;1");
+	//Load art and hair art
+	IO_Data arc_load[2];
+	IO_ReadBatch((const char *[]){
+		"\\CHAR\\MOM.ARC;1",
+		"\\CHAR\\MOMHAIR.TIM;1",
+	}, arc_load, 2);
+	this->arc_main = arc_load[0];
+	Gfx_LoadTex(&this->tex_hair, arc_load[1], GFX_LOADTEX_FREE);
 	
 	const char **pathp = (const char *[]){
 		"idle0.tim", //Mom_ArcMain_Idle0
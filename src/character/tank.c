@@ -213,8 +213,14 @@ Character *Char_Tank_New(fixed_t x, fixed_t y)
 	this->character.focus_y = FIXED_DEC(-80,1);
 	this->character.focus_zoom = FIXED_DEC(1,1);
 	
-	//Load art
-	this->arc_main = IO_Read("\\CHAR\\TANK.ARC;1");
+	//Load art and scene art together
+	IO_Data arc_load[2];
+	IO_ReadBatch((const char *[]){
+		"\\CHAR\\TANK.ARC;1",
+		(stage.stage_id == StageId_7_1) ? "\\CHAR\\TANKUGH.ARC;1" :
+		(stage.stage_id == StageId_7_3) ? "\\CHAR\\TANKGOOD.ARC;1" : NULL,
+	}, arc_load, 2);
+	this->arc_main = arc_load[0];
 	
 	const char **pathp = (const char *[]){
 		"idle0.tim", //Tank_ArcMain_Idle0
@@ -234,8 +240,8 @@ Character *Char_Tank_New(fixed_t x, fixed_t y)
 	{
 		case StageId_7_1: //Ugh
 		{
-			//Load "Ugh" art
-			this->arc_scene = IO_Read("\\CHAR\\TANKUGH.ARC;1");
+			//Get "Ugh" art
+			this->arc_scene = arc_load[1];
 			
 			const char **pathp = (const char *[]){
 				"ugh0.tim", //Tank_ArcScene_0
@@ -249,8 +255,8 @@ Character *Char_Tank_New(fixed_t x, fixed_t y)
 		}
 		case StageId_7_3: //Stress
 		{
-			//Load "Heh, pretty good!" art
-			this->arc_scene = IO_Read("\\CHAR\\TANKGOOD.ARC;1");
+			//Get "Heh, pretty good!" art
+			this->arc_scene = arc_load[1];
 			
 			const char **pathp = (const char *[]){
 				"good0.tim", //Tank_ArcScene_0
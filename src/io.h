@@ -23,7 +23,56 @@ IO_Data IO_ReadFile(CdlFILE *file);
 IO_Data IO_AsyncReadFile(CdlFILE *file);
 IO_Data IO_Read(const char *path);
 IO_Data IO_AsyncRead(const char *path);
+void IO_ReadBatch(const char **paths, IO_Data *out, size_t n); //NULL paths are skipped and give NULL
+IO_Data IO_ReadPart(CdlFILE *file, size_t pos, size_t size); //pos must be on a sector, size is cut down to the end of the file
+IO_Data IO_AsyncReadPart(CdlFILE *file, size_t pos, size_t size);
 boolean IO_IsSeeking(void);
 boolean IO_IsReading(void);
+boolean IO_IsDone(IO_Data data);
+void IO_Wait(void);
+
+#ifdef PSXF_PC
+	//Prefetching, IO_ReadFile takes over prefetched files and the hook sees every file read
+	void IO_Prefetch(CdlFILE *file);
+	void IO_PrefetchClear(void);
+	void IO_SetReadHook(void (*hook)(CdlFILE *file));
+	
+	//Load telemetry, collected between IO_StatsBegin and IO_StatsEnd
+	#define IO_STATS_FILES 48
+	
+	typedef enum
+	{
+		IO_StatsHow_Read,
+		IO_StatsHow_Prefetch,
+		IO_StatsHow_Map,
+		IO_StatsHow_Async,
+	} IO_StatsHow;
+	
+	typedef struct
+	{
+		const char *name;
+		double start;
+		u32 us;
+		
+		u32 files, bytes, hits, maps, read_us;
+		u32 texs, tex_us;
+		u32 finds, find_us;
+		
+		u8 file_num;
+		struct
+		{
+			char path[32];
+			u32 bytes, us;
+			u8 how;
+		} file[IO_STATS_FILES];
+	} IO_Stats;
+	
+	void IO_StatsBegin(const char *name);
+	void IO_StatsEnd(void);
+	const IO_Stats *IO_GetStats(void);
+	double IO_StatsTime(void);
+	void IO_StatsTex(double start);
+	void IO_StatsFind(double start);
+#endif
 
 #endif
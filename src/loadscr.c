@@ -12,6 +12,40 @@
 #include "audio.h"
 #include "trans.h"
 #include "network.h"
+#include "font.h"
+
+//Loading screen constants
+#ifdef PSXF_PC
+ //#define LOADSCR_STATS //Show telemetry of the last load over the loading screen, it stays up while the next load runs
+#endif
+
+#ifdef LOADSCR_STATS
+static FontData loadscr_font;
+static char loadscr_stats[4][64];
+static boolean loadscr_stats_has;
+
+static void LoadScr_FormatStats(void)
+{
+	//Format telemetry of the last load, there's none before the first one
+	const IO_Stats *stats = IO_GetStats();
+	if (!(loadscr_stats_has = stats->name != NULL))
+		return;
+	sprintf(loadscr_stats[0], "%s %u ms", stats->name, (unsigned int)(stats->us / 1000));
+	sprintf(loadscr_stats[1], "%u files %u KB in %u ms", (unsigned int)stats->files, (unsigned int)(stats->bytes >> 10), (unsigned int)(stats->read_us / 1000));
+	sprintf(loadscr_stats[2], "%u prefetched %u mapped", (unsigned int)stats->hits, (unsigned int)stats->maps);
+	sprintf(loadscr_stats[3], "%u textures in %u ms", (unsigned int)stats->texs, (unsigned int)(stats->tex_us / 1000));
+	
+	FontData_Load(&loadscr_font, Font_Arial);
+}
+
+static void LoadScr_DrawStats(void)
+{
+	if (!loadscr_stats_has)
+		return;
+	for (int i = 0; i < 4; i++)
+		loadscr_font.draw(&loadscr_font, loadscr_stats[i], 8, 8 + i * 10, FontAlign_Left);
+}
+#endif
 
 //Loading screen functions
 void LoadScr_Start(void)
@@ -27,6 +61,9 @@ void LoadScr_Start(void)
 	Gfx_Tex loading_tex;
 	Gfx_SetClear(202, 255, 77);
 	Gfx_LoadTex(&loading_tex, IO_Read("\\MENU\\LOADING.TIM;1"), GFX_LOADTEX_FREE);
+	#ifdef LOADSCR_STATS
+		LoadScr_FormatStats();
+	#endif
 	Timer_Reset();
 	
 	//Draw loading screen and run transition
@@ -37,12 +74,18 @@ void LoadScr_Start(void)
 		//Draw loading screen and end frame
 		Timer_Tick();
 		Trans_Tick();
+		#ifdef LOADSCR_STATS
+			LoadScr_DrawStats();
+		#endif
 		Gfx_DrawTex(&loading_tex, &loading_src, &loading_dst);
 		Network_Process();
 		Gfx_Flip();
 	}
 	
-	//Draw an extra frame to avoid double buffering issues
+	//Draw an extra frame to avoid double buffering issues, this one stays up while loading
+	#ifdef LOADSCR_STATS
+		LoadScr_DrawStats();
+	#endif
 	Gfx_DrawTex(&loading_tex, &loading_src, &loading_dst);
 	Network_Process();
 	Gfx_Flip();
@@ -43,10 +43,94 @@ void ErrorLock(void)
 #include "mem.h"
 #undef MEM_IMPLEMENTATION
 
+#ifdef PSXF_PC
+ #define MEM_GROW //Add regions from malloc once malloc_heap is full, so PC content isn't held to PSX memory
+#endif
+#define MEM_GROW_CHUNK 0x1000000  //Smallest region added at once
+#define MEM_GROW_CAP   0x10000000 //Most the heap may grow past malloc_heap
+
 #ifndef PSXF_STDMEM
 static u8 malloc_heap[0x190000];
+
+#ifdef MEM_GROW
+	#include <stdlib.h>
+	
+	static size_t mem_grown;
+	
+	static void *Main_HeapGrow(size_t *size)
+	{
+		//Grow in whole chunks up to the cap, regions live until the game exits
+		size_t chunk = (*size + MEM_GROW_CHUNK - 1) / MEM_GROW_CHUNK * MEM_GROW_CHUNK;
+		if (mem_grown + chunk > MEM_GROW_CAP)
+			return NULL;
+		void *region = malloc(chunk);
+		if (region == NULL)
+			return NULL;
+		mem_grown += chunk;
+		*size = chunk;
+		return region;
+	}
+#endif
+#endif
+
+//Memory tracking
+#ifdef MEM_STAT
+	static const char *mem_tag_name[MemTag_Max] = {
+		"misc",
+		"io",
+		"gfx",
+		"chart",
+		"char",
+		"object",
+		"audio",
+	};
+	static size_t mem_snap[MemTag_Max];
 #endif
 
+void MemStat_Begin(void)
+{
+	#ifdef MEM_STAT
+		//Remember what each tag held before
+		for (int i = 0; i < MemTag_Max; i++)
+			Mem_GetTagStat(i, &mem_snap[i], NULL);
+	#endif
+}
+
+void MemStat_Leaks(const char *name)
+{
+	#ifdef MEM_STAT
+		//Anything a tag holds over what it held at MemStat_Begin was never freed
+		//The song stays loaded until the next one replaces it, so audio isn't checked
+		for (int i = 0; i < MemTag_Max; i++)
+		{
+			if (i == MemTag_Audio)
+				continue;
+			size_t used;
+			Mem_GetTagStat(i, &used, NULL);
+			if (used > mem_snap[i])
+				printf("[MemStat_Leaks] %s leaked 0x%X bytes of %s\n", name, (unsigned int)(used - mem_snap[i]), mem_tag_name[i]);
+		}
+	#else
+		(void)name;
+	#endif
+}
+
+void MemStat_End(const char *name)
+{
+	#ifdef MEM_STAT
+		for (int i = 0; i < MemTag_Max; i++)
+		{
+			size_t used, max;
+			Mem_GetTagStat(i, &used, &max);
+			
+			//Dump as CSV lines for spreadsheets, grep for memstat
+			printf("memstat,%s,%s,%u,%u,%u\n", name, mem_tag_name[i], (unsigned int)mem_snap[i], (unsigned int)used, (unsigned int)max);
+		}
+	#else
+		(void)name;
+	#endif
+}
+
 //Entry point
 int main(int argc, char **argv)
 {
@@ -58,6 +142,9 @@ int main(int argc, char **argv)
 	PSX_Init();
 	
 	Mem_Init((void*)malloc_heap, sizeof(malloc_heap));
+	#if defined(MEM_GROW) && !defined(PSXF_STDMEM)
+		Mem_SetGrow(Main_HeapGrow);
+	#endif
 	
 	IO_Init();
 	Audio_Init();
@@ -85,6 +172,11 @@ int main(int argc, char **argv)
 			Mem_GetStat(&mem_used, &mem_size, &mem_max);
 			#ifndef MEM_BAR
 				FntPrint("mem: %08X/%08X (max %08X)\n", mem_used, mem_size, mem_max);
+				for (int i = 0; i < MemTag_Max; i++)
+				{
+					Mem_GetTagStat(i, &mem_used, &mem_max);
+					FntPrint(" %-6s %08X (max %08X)\n", mem_tag_name[i], mem_used, mem_max);
+				}
 			#endif
 		#endif
 		
@@ -20,4 +20,23 @@ extern GameLoop gameloop;
 extern char error_msg[0x200];
 void ErrorLock();
 
+//Memory tags, what Mem_SetTag is given so heap use can be told apart by subsystem
+typedef enum
+{
+	MemTag_Misc,
+	MemTag_IO, //Prefetched files waiting for whoever reads them
+	MemTag_Gfx,
+	MemTag_Chart,
+	MemTag_Character,
+	MemTag_Object,
+	MemTag_Audio, //Songs being played, counted from outside the heap on PC
+	
+	MemTag_Max,
+} MemTag;
+
+//Memory tracking, does nothing unless MEM_STAT is defined in main.c
+void MemStat_Begin(void);
+void MemStat_Leaks(const char *name); //Call after popping the scope, anything still held escaped it
+void MemStat_End(const char *name);
+
 #endif
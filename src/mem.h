@@ -1,12 +1,24 @@
 /*
 	"mem" by Regan "CuckyDev" Green:
-	A tiny portable C89 memory allocator.
+	A tiny portable C99 memory allocator.
+	Allocations and frees take constant time, see the implementation for how.
 	
 	This is a single-header library. You must include this file alongside `#define MEM_IMPLEMENTATION` in one file in order to use.
 	You can then include `mem.h` in other files for the function declarations.
 	
 	Additional control defines:
-	MEM_STAT - This will enable the Mem_GetStat function which returns information about available memory in the heap.
+	MEM_STAT - This will enable the Mem_GetStat function which returns information about available memory in the heap,
+	           and Mem_GetTagStat which returns the same for allocations made under each tag given to Mem_SetTag.
+	           Memory from outside the heap can be counted under a tag with Mem_CountTag, it doesn't count towards Mem_GetStat.
+	
+	Pointers that don't belong to the heap (such as mapped files) can be passed to Mem_Free if a handler for them is given to Mem_SetForeign.
+	
+	More memory can be handed to the heap with Mem_AddRegion, or on demand by a function given to Mem_SetGrow that is asked for a region whenever an allocation doesn't fit.
+	
+	Mem_PushScope and Mem_PopScope bracket data that lives and dies together.
+	While a scope is open allocations are carved linearly from one reserved block, and popping the scope releases everything it allocated at once.
+	Blocks a scope couldn't carve (and pointers handed to it with Mem_Adopt, such as mapped files) are remembered and freed when it's popped.
+	With PSXF_STDMEM every allocation is linked into its scope's list instead, so popping frees the same things.
 */
 
 #ifndef MEM_GUARD_MEM_H
@@ -18,6 +30,9 @@
 #define MEM_ALIGNSIZE 0x10
 #define MEM_ALIGN(x) (((size_t)(x) + 0xF) & ~0xF)
 
+#define MEM_TAG_MAX 8 /* Tags go from 0 to MEM_TAG_MAX - 1 */
+#define MEM_SCOPE_MAX 4 /* Scopes that can be open at once */
+
 #ifdef PSXF_STDMEM
 
 #include <stdlib.h>
@@ -25,8 +40,112 @@
 #undef MEM_STAT /* Control unsupported */
 
 #define Mem_Init(x,y)
-#define Mem_Alloc malloc
-#define Mem_Free free
+#define Mem_SetForeign(x) /* Can't tell foreign pointers apart */
+#define Mem_AddRegion(x,y) 1
+#define Mem_SetGrow(x)
+#define Mem_Retag(x) ((void)(x))
+#define Mem_CountTag(x,y) ((void)(x), (void)(y))
+
+/* Function declarations */
+void *Mem_Alloc(size_t size);
+void Mem_Free(void *ptr);
+int Mem_PushScope(void);
+void Mem_PopScope(void);
+void Mem_Adopt(void *ptr);
+int Mem_SetTag(int tag); /* Tags aren't tracked, always returns 0 */
+
+/* Implementation */
+#ifdef MEM_IMPLEMENTATION
+
+/* Each allocation is prefixed with a link into the list of the scope that was open when it was made, list 0 is for no scope */
+typedef struct Mem_Link
+{
+	struct Mem_Link *prev, *next;
+	int scope;
+} Mem_Link;
+#define MEM_LINKSIZE (MEM_ALIGN(sizeof(Mem_Link)))
+
+static Mem_Link *mem_scope_list[MEM_SCOPE_MAX + 1];
+static int mem_scopes = 0;
+
+static void Mem_ListAdd(Mem_Link *link, int scope)
+{
+	link->scope = scope;
+	link->prev = NULL;
+	if ((link->next = mem_scope_list[scope]) != NULL)
+		link->next->prev = link;
+	mem_scope_list[scope] = link;
+}
+
+static void Mem_ListRemove(Mem_Link *link)
+{
+	if (link->next != NULL)
+		link->next->prev = link->prev;
+	if (link->prev != NULL)
+		link->prev->next = link->next;
+	else
+		mem_scope_list[link->scope] = link->next;
+}
+
+void *Mem_Alloc(size_t size)
+{
+	Mem_Link *link = (Mem_Link*)malloc(MEM_LINKSIZE + size);
+	if (link == NULL)
+		return NULL;
+	Mem_ListAdd(link, mem_scopes);
+	return (void*)((char*)link + MEM_LINKSIZE);
+}
+
+void Mem_Free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	Mem_Link *link = (Mem_Link*)((char*)ptr - MEM_LINKSIZE);
+	Mem_ListRemove(link);
+	free(link);
+}
+
+int Mem_PushScope(void)
+{
+	if (mem_scopes >= MEM_SCOPE_MAX)
+		return 1;
+	mem_scope_list[++mem_scopes] = NULL;
+	return 0;
+}
+
+void Mem_PopScope(void)
+{
+	if (mem_scopes == 0)
+		return;
+	
+	/* Free everything still in the scope's list */
+	Mem_Link *link = mem_scope_list[mem_scopes];
+	while (link != NULL)
+	{
+		Mem_Link *next = link->next;
+		free(link);
+		link = next;
+	}
+	mem_scope_list[mem_scopes--] = NULL;
+}
+
+void Mem_Adopt(void *ptr)
+{
+	/* Move the allocation into the innermost scope's list */
+	if (ptr == NULL || mem_scopes == 0)
+		return;
+	Mem_Link *link = (Mem_Link*)((char*)ptr - MEM_LINKSIZE);
+	Mem_ListRemove(link);
+	Mem_ListAdd(link, mem_scopes);
+}
+
+int Mem_SetTag(int tag)
+{
+	(void)tag;
+	return 0;
+}
+
+#endif /* MEM_IMPLEMENTATION */
 
 #else
 
@@ -34,47 +153,380 @@
 int Mem_Init(void *ptr, size_t size);
 void *Mem_Alloc(size_t size);
 void Mem_Free(void *ptr);
+void Mem_SetForeign(void (*func)(void *ptr));
+int Mem_AddRegion(void *ptr, size_t size);
+void Mem_SetGrow(void *(*func)(size_t *size)); /* func is given the smallest size that will do, it may raise it and returns NULL to refuse */
+int Mem_PushScope(void);
+void Mem_PopScope(void);
+void Mem_Adopt(void *ptr); /* Has the innermost scope free a pointer from outside its arena when it's popped */
+int Mem_SetTag(int tag); /* Returns the previous tag */
+void Mem_Retag(void *ptr); /* Counts an allocation under the current tag, for blocks handed from one subsystem to another */
+void Mem_CountTag(int tag, ptrdiff_t size); /* Counts memory from outside the heap under a tag, negative when it's released */
 #ifdef MEM_STAT
 	void Mem_GetStat(size_t *used, size_t *size, size_t *max);
+	void Mem_GetTagStat(int tag, size_t *used, size_t *max);
 #endif
 
 /* Implementation */
 #ifdef MEM_IMPLEMENTATION
 
+/*
+	Two-level segregated fit (TLSF) allocator.
+	Free blocks are kept in lists by size class, the first level splits sizes by power of two and the second level splits each power of two into MEM_SL_COUNT ranges.
+	A bitmap for each level finds a non-empty list large enough for a request without walking anything, so allocating and freeing take the same time however full the heap is.
+	Requests are rounded up to the next size class first, so the head of any list found is sure to fit and nothing is ever walked.
+	That costs up to 1/MEM_SL_COUNT of a request in blocks that are passed over, which is the usual TLSF trade.
+	Blocks are merged with their free neighbours as soon as they're freed.
+*/
+#define MEM_SL_LOG2  4
+#define MEM_SL_COUNT (1 << MEM_SL_LOG2)
+#define MEM_FL_SHIFT (MEM_SL_LOG2 + 4) /* Sizes below 1 << MEM_FL_SHIFT go in first level 0, split linearly by MEM_ALIGNSIZE */
+#define MEM_FL_COUNT 24
+#define MEM_MAXSIZE  ((size_t)1 << (MEM_FL_COUNT + MEM_FL_SHIFT - 1)) /* Blocks must be smaller than this */
+
+#define MEM_REGION_MAX 16 /* Regions the heap can be made of */
+#define MEM_OWN_MAX 256 /* Pointers from outside the arena that open scopes can own, any more escape their scope */
+
 typedef struct Mem_Header
 {
-	struct Mem_Header *prev, *next;
-	size_t size;
+	struct Mem_Header *prev_phys; /* Block before this one in memory, NULL for the first */
+	size_t size; /* Size of block including header, bit 0 is set if it's free */
+	
+	/* Only valid while the block is free, these lie in what would be the allocation */
+	struct Mem_Header *prev_free, *next_free;
 } Mem_Header;
-#define MEM_HEDSIZE (MEM_ALIGN(sizeof(Mem_Header)))
+#define MEM_HEDSIZE (MEM_ALIGN(sizeof(Mem_Header) - 2 * sizeof(Mem_Header*)))
+#define MEM_MINSIZE (MEM_ALIGN(sizeof(Mem_Header)))
+
+/* The low bits of a size are free since blocks are aligned, under MEM_STAT allocated blocks keep their tag above the free bit */
+#define MEM_FREE_BIT ((size_t)1)
+#define MEM_TAG_SHIFT 1
+#define MEM_TAG_MASK ((size_t)(MEM_TAG_MAX - 1) << MEM_TAG_SHIFT)
+#define Mem_BlockSize(block) ((block)->size & ~(size_t)(MEM_ALIGNSIZE - 1))
+#define Mem_BlockNext(block) ((Mem_Header*)((char*)(block) + Mem_BlockSize(block)))
 
-static Mem_Header *mem = NULL;
+/* Each region ends with a sentinel header that's never free, so blocks never merge from one region into the next */
+typedef struct
+{
+	char *start, *end; /* end is where the sentinel is */
+} Mem_Region;
+static Mem_Region mem_region[MEM_REGION_MAX];
+static int mem_regions = 0;
+static size_t mem_size;
+static void *(*mem_grow)(size_t *size) = NULL;
+static unsigned int mem_fl_map, mem_sl_map[MEM_FL_COUNT];
+static Mem_Header *mem_free[MEM_FL_COUNT][MEM_SL_COUNT];
+static void (*mem_foreign)(void *ptr) = NULL;
+static int mem_tag;
 #ifdef MEM_STAT
 	static size_t mem_used, mem_max;
+	static size_t mem_tag_used[MEM_TAG_MAX], mem_tag_max[MEM_TAG_MAX];
 #endif
 
-int Mem_Init(void *ptr, size_t size)
+/*
+	Scopes take the largest free block as their arena and carve allocations off its top in order.
+	The top is kept as a header covering the rest of the arena, so the blocks in an arena always chain like any others.
+	Freeing the block just under the top brings the top back down, anything else freed in the arena becomes a normal free block until the top reaches it or the scope is popped.
+*/
+static char *mem_arena = NULL, *mem_arena_end = NULL; /* NULL if no scope has an arena */
+static Mem_Header *mem_arena_top;
+static Mem_Header *mem_scope_mark[MEM_SCOPE_MAX]; /* Top when each scope was pushed */
+static int mem_scopes;
+
+/* Pointers scopes will free when popped, in the order they were taken so inner scopes' are last */
+static struct
+{
+	void *ptr;
+	int scope;
+} mem_own[MEM_OWN_MAX];
+static int mem_owns;
+
+static int Mem_FLS(size_t x)
+{
+	/* Index of the highest set bit of a non-zero value, binary search keeps it to a fixed number of steps */
+	int i = 0;
+	int step = sizeof(size_t) * 4;
+	for (; step != 0; step >>= 1)
+	{
+		if ((x >> step) != 0)
+		{
+			x >>= step;
+			i += step;
+		}
+	}
+	return i;
+}
+
+static int Mem_FFS(unsigned int x)
+{
+	/* Index of the lowest set bit of a non-zero value */
+	return Mem_FLS(x & (~x + 1));
+}
+
+static void Mem_Mapping(size_t size, int *fl, int *sl)
+{
+	/* Get list indices of a block size */
+	if (size < ((size_t)1 << MEM_FL_SHIFT))
+	{
+		*fl = 0;
+		*sl = (int)(size / MEM_ALIGNSIZE);
+	}
+	else
+	{
+		int bit = Mem_FLS(size);
+		*sl = (int)(size >> (bit - MEM_SL_LOG2)) ^ MEM_SL_COUNT;
+		*fl = bit - MEM_FL_SHIFT + 1;
+	}
+}
+
+static void Mem_Unlink(Mem_Header *block, int fl, int sl)
+{
+	/* Remove block from its free list, clearing the bitmaps if the list empties */
+	if (block->next_free != NULL)
+		block->next_free->prev_free = block->prev_free;
+	if (block->prev_free != NULL)
+	{
+		block->prev_free->next_free = block->next_free;
+	}
+	else if ((mem_free[fl][sl] = block->next_free) == NULL)
+	{
+		if ((mem_sl_map[fl] &= ~(1U << sl)) == 0)
+			mem_fl_map &= ~(1U << fl);
+	}
+}
+
+static void Mem_Remove(Mem_Header *block)
+{
+	int fl, sl;
+	Mem_Mapping(Mem_BlockSize(block), &fl, &sl);
+	Mem_Unlink(block, fl, sl);
+}
+
+static void Mem_Insert(Mem_Header *block)
+{
+	/* Mark block free and push it on the list for its size */
+	int fl, sl;
+	Mem_Mapping(Mem_BlockSize(block), &fl, &sl);
+	block->size |= MEM_FREE_BIT;
+	block->prev_free = NULL;
+	if ((block->next_free = mem_free[fl][sl]) != NULL)
+		block->next_free->prev_free = block;
+	mem_free[fl][sl] = block;
+	mem_fl_map |= 1U << fl;
+	mem_sl_map[fl] |= 1U << sl;
+}
+
+static size_t Mem_RoundUp(size_t size)
+{
+	/* Round up to the smallest size in the next list, so any block in that list fits */
+	if (size < ((size_t)1 << MEM_FL_SHIFT))
+		return size;
+	size_t step = (size_t)1 << (Mem_FLS(size) - MEM_SL_LOG2);
+	return (size + step - 1) & ~(step - 1);
+}
+
+static Mem_Header *Mem_Find(size_t size)
+{
+	/* Find a non-empty list at least as large as the rounded request */
+	int fl, sl;
+	Mem_Mapping(Mem_RoundUp(size), &fl, &sl);
+	if (fl >= MEM_FL_COUNT)
+		return NULL;
+	
+	unsigned int sl_map = mem_sl_map[fl] & (~0U << sl);
+	if (sl_map == 0)
+	{
+		unsigned int fl_map = (fl + 1 < MEM_FL_COUNT) ? (mem_fl_map & (~0U << (fl + 1))) : 0;
+		if (fl_map == 0)
+			return NULL;
+		fl = Mem_FFS(fl_map);
+		sl_map = mem_sl_map[fl];
+	}
+	
+	/* Take the head of the list */
+	sl = Mem_FFS(sl_map);
+	Mem_Header *head = mem_free[fl][sl];
+	Mem_Unlink(head, fl, sl);
+	return head;
+}
+
+static int Mem_IsEdge(Mem_Header *block)
+{
+	/* Blocks never merge across the edge of an arena or where a scope starts, so popping can find its blocks */
+	int i;
+	if ((char*)block == mem_arena || (char*)block == mem_arena_end)
+		return 1;
+	for (i = 0; i < mem_scopes; i++)
+		if (mem_scope_mark[i] == block)
+			return 1;
+	return 0;
+}
+
+static void Mem_Release(Mem_Header *head)
+{
+	/* Merge with the next block if it's free */
+	Mem_Header *next = Mem_BlockNext(head);
+	if ((next->size & MEM_FREE_BIT) && !Mem_IsEdge(next))
+	{
+		Mem_Remove(next);
+		head->size += Mem_BlockSize(next);
+	}
+	
+	/* Merge with the previous block if it's free */
+	Mem_Header *prev = head->prev_phys;
+	if (prev != NULL && (prev->size & MEM_FREE_BIT) && !Mem_IsEdge(head))
+	{
+		Mem_Remove(prev);
+		prev->size = Mem_BlockSize(prev) + head->size;
+		head = prev;
+	}
+	
+	/* Point the following block back at the merged one */
+	Mem_BlockNext(head)->prev_phys = head;
+	Mem_Insert(head);
+}
+
+static void Mem_SetTop(Mem_Header *top)
+{
+	/* Make the top cover the rest of the arena */
+	top->size = mem_arena_end - (char*)top;
+	mem_arena_top = top;
+	((Mem_Header*)mem_arena_end)->prev_phys = top;
+	
+	/* Scopes the top has come down past start at the top now */
+	int i;
+	for (i = 0; i < mem_scopes; i++)
+		if (mem_scope_mark[i] > top)
+			mem_scope_mark[i] = top;
+}
+
+static Mem_Header *Mem_Carve(size_t size)
 {
-	/* Make sure there's enough space for mem header */
-	if (ptr == NULL || size < MEM_HEDSIZE)
+	/* Take block off the top of the arena, leaving room for the top's header */
+	Mem_Header *head = mem_arena_top;
+	if ((size_t)(mem_arena_end - (char*)head) < size + MEM_MINSIZE)
+		return NULL;
+	head->size = size;
+	
+	Mem_Header *top = (Mem_Header*)((char*)head + size);
+	top->prev_phys = head;
+	Mem_SetTop(top);
+	return head;
+}
+
+int Mem_AddRegion(void *ptr, size_t size)
+{
+	/* Make sure there's enough space for a block and the sentinel */
+	if (ptr == NULL || mem_regions >= MEM_REGION_MAX)
+		return 1;
+	char *start = (char*)MEM_ALIGN(ptr);
+	if (size < (size_t)(start - (char*)ptr) + MEM_MINSIZE + MEM_HEDSIZE)
 		return 1;
 	
-	/* Get mem pointer and available range (after 16 byte alignment) */
-	mem = (Mem_Header*)MEM_ALIGN(ptr);
+	/* Get available range (after 16 byte alignment) */
+	size = (size - (start - (char*)ptr)) & ~(size_t)(MEM_ALIGNSIZE - 1);
+	if (size >= MEM_MAXSIZE)
+		size = MEM_MAXSIZE - MEM_ALIGNSIZE;
+	size -= MEM_HEDSIZE;
 	
-	/* Initial mem header */
-	mem->prev = NULL;
-	mem->next = NULL;
-	mem->size = ((char*)ptr + size) - (char*)mem;
+	/* Region starts as one free block followed by the sentinel */
+	Mem_Header *block = (Mem_Header*)start;
+	block->prev_phys = NULL;
+	block->size = size;
+	Mem_Header *end = Mem_BlockNext(block);
+	end->prev_phys = block;
+	end->size = 0;
+	Mem_Insert(block);
+	
+	mem_region[mem_regions].start = start;
+	mem_region[mem_regions].end = (char*)end;
+	mem_regions++;
+	mem_size += size;
+	return 0;
+}
+
+int Mem_Init(void *ptr, size_t size)
+{
+	/* Clear free lists */
+	int fl, sl;
+	mem_fl_map = 0;
+	for (fl = 0; fl < MEM_FL_COUNT; fl++)
+	{
+		mem_sl_map[fl] = 0;
+		for (sl = 0; sl < MEM_SL_COUNT; sl++)
+			mem_free[fl][sl] = NULL;
+	}
+	
+	/* Heap starts as the given region */
+	mem_regions = 0;
+	mem_size = 0;
+	if (Mem_AddRegion(ptr, size))
+		return 1;
 	
 	/* Initial mem state */
+	mem_arena = mem_arena_end = NULL;
+	mem_scopes = 0;
+	mem_owns = 0;
+	mem_tag = 0;
 	#ifdef MEM_STAT
-		mem_max = mem_used = MEM_HEDSIZE;
+		mem_max = mem_used = 0;
+		for (fl = 0; fl < MEM_TAG_MAX; fl++)
+			mem_tag_max[fl] = mem_tag_used[fl] = 0;
 	#endif
 	
 	return 0;
 }
 
+static int Mem_InHeap(void *ptr)
+{
+	int i;
+	for (i = 0; i < mem_regions; i++)
+		if ((char*)ptr >= mem_region[i].start && (char*)ptr < mem_region[i].end)
+			return 1;
+	return 0;
+}
+
+static Mem_Header *Mem_Grow(size_t size)
+{
+	/* Ask for a region with room for the rounded block, its alignment and the sentinel */
+	if (mem_grow == NULL || mem_regions >= MEM_REGION_MAX)
+		return NULL;
+	size_t region_size = Mem_RoundUp(size) + MEM_ALIGNSIZE + MEM_HEDSIZE;
+	void *region = mem_grow(&region_size);
+	if (region == NULL || Mem_AddRegion(region, region_size))
+		return NULL;
+	return Mem_Find(size);
+}
+
+static void Mem_Own(void *ptr)
+{
+	/* Have the innermost scope free the pointer when it's popped, if it's not already owned */
+	int i;
+	for (i = mem_owns - 1; i >= 0; i--)
+		if (mem_own[i].ptr == ptr)
+			return;
+	if (mem_owns >= MEM_OWN_MAX)
+		return;
+	mem_own[mem_owns].ptr = ptr;
+	mem_own[mem_owns].scope = mem_scopes;
+	mem_owns++;
+}
+
+static void Mem_Disown(void *ptr)
+{
+	int i;
+	for (i = mem_owns - 1; i >= 0; i--)
+	{
+		if (mem_own[i].ptr == ptr)
+		{
+			/* Keep the rest in order */
+			for (mem_owns--; i < mem_owns; i++)
+				mem_own[i] = mem_own[i + 1];
+			return;
+		}
+	}
+}
+
 static Mem_Header *Mem_GetHeader(void *ptr)
 {
 	if (ptr == NULL)
@@ -85,64 +537,52 @@ static Mem_Header *Mem_GetHeader(void *ptr)
 void *Mem_Alloc(size_t size)
 {
 	/* Ensure we have a heap */
-	if (mem == NULL)
+	if (mem_regions == 0 || size >= MEM_MAXSIZE)
 		return NULL;
 	
 	/* Get true size we have to fit */
 	size = MEM_ALIGN(size + MEM_HEDSIZE);
+	if (size < MEM_MINSIZE)
+		size = MEM_MINSIZE;
 	
-	/* Get header pointer */
-	Mem_Header *head, *prev, *next;
-	char *hpos = (char*)mem + MEM_HEDSIZE;
-	
-	prev = mem;
-	next = prev->next;
-	
-	while (1)
+	/* Carve from the open scope's arena, or find and take a free block */
+	Mem_Header *head;
+	int owned = 0;
+	if (mem_arena == NULL || (head = Mem_Carve(size)) == NULL)
 	{
-		if (next != NULL)
-		{
-			/* Check against the next block */
-			size_t cleft = (char*)next - hpos;
-			if (cleft >= size)
-			{
-				/* Set pointer */
-				head = (Mem_Header*)hpos;
-				break;
-			}
-			
-			/* Check next header */
-			hpos = (char*)next + next->size;
-			prev = next;
-			next = prev->next;
-		}
-		else
+		owned = (mem_scopes != 0);
+		if ((head = Mem_Find(size)) == NULL && (head = Mem_Grow(size)) == NULL)
+			return NULL;
+		head->size &= ~MEM_FREE_BIT;
+		
+		/* Split off what's left over if it can make a block */
+		if (head->size - size >= MEM_MINSIZE)
 		{
-			/* Check against end of heap */
-			size_t cleft = ((char*)mem + mem->size) - hpos;
-			if (cleft < size)
-				return NULL;
+			Mem_Header *rest = (Mem_Header*)((char*)head + size);
+			rest->prev_phys = head;
+			rest->size = head->size - size;
+			head->size = size;
 			
-			/* Set pointer */
-			head = (Mem_Header*)hpos;
-			break;
+			Mem_BlockNext(rest)->prev_phys = rest;
+			Mem_Insert(rest);
 		}
 	}
 	
-	/* Link header */
-	head->size = size;
-	head->prev = prev;
-	if ((head->next = prev->next) != NULL)
-		head->next->prev = head;
-	prev->next = head;
-	
 	#ifdef MEM_STAT
-		/* Update stats */
+		/* Update stats and tag block */
+		size = head->size;
 		if ((mem_used += size) >= mem_max)
 			mem_max = mem_used;
+		if ((mem_tag_used[mem_tag] += size) >= mem_tag_max[mem_tag])
+			mem_tag_max[mem_tag] = mem_tag_used[mem_tag];
+		head->size |= (size_t)mem_tag << MEM_TAG_SHIFT;
 	#endif
 	
-	return (void*)(hpos + MEM_HEDSIZE);
+	/* Blocks from outside the arena are freed by the scope when it's popped */
+	void *ptr = (void*)((char*)head + MEM_HEDSIZE);
+	if (owned)
+		Mem_Own(ptr);
+	return ptr;
 }
 
 void Mem_Free(void *ptr)
@@ -150,15 +590,158 @@ void Mem_Free(void *ptr)
 	/* Get header of pointer */
 	if (ptr == NULL)
 		return;
+	if (mem_owns != 0)
+		Mem_Disown(ptr);
+	
+	/* Hand pointers from outside the heap to the foreign handler */
+	if (mem_foreign != NULL && !Mem_InHeap(ptr))
+	{
+		mem_foreign(ptr);
+		return;
+	}
+	
 	Mem_Header *head = Mem_GetHeader(ptr);
 	
-	/* Unlink header */
-	if ((head->prev->next = head->next) != NULL)
-		head->next->prev = head->prev;
+	#ifdef MEM_STAT
+		/* Update stats and untag block */
+		mem_used -= Mem_BlockSize(head);
+		mem_tag_used[(head->size & MEM_TAG_MASK) >> MEM_TAG_SHIFT] -= Mem_BlockSize(head);
+		head->size &= ~MEM_TAG_MASK;
+	#endif
+	
+	/* Freeing the block under an arena's top brings the top down over it and any free block below */
+	if (Mem_BlockNext(head) == mem_arena_top && (char*)head >= mem_arena && (char*)head < mem_arena_end)
+	{
+		Mem_Header *prev = head->prev_phys;
+		if ((char*)prev >= mem_arena && (prev->size & MEM_FREE_BIT))
+		{
+			Mem_Remove(prev);
+			head = prev;
+		}
+		Mem_SetTop(head);
+		return;
+	}
+	
+	Mem_Release(head);
+}
+
+void Mem_Adopt(void *ptr)
+{
+	/* The arena is already freed by the pop */
+	if (ptr == NULL || mem_scopes == 0 || ((char*)ptr >= mem_arena && (char*)ptr < mem_arena_end))
+		return;
+	Mem_Own(ptr);
+}
+
+void Mem_SetForeign(void (*func)(void *ptr))
+{
+	mem_foreign = func;
+}
+
+void Mem_SetGrow(void *(*func)(size_t *size))
+{
+	mem_grow = func;
+}
+
+int Mem_PushScope(void)
+{
+	if (mem_regions == 0 || mem_scopes >= MEM_SCOPE_MAX)
+		return 1;
+	
+	/* Outermost scope reserves the largest free block as its arena */
+	if (mem_scopes == 0 && mem_fl_map != 0)
+	{
+		int fl = Mem_FLS(mem_fl_map);
+		int sl = Mem_FLS(mem_sl_map[fl]);
+		Mem_Header *arena = mem_free[fl][sl];
+		Mem_Unlink(arena, fl, sl);
+		arena->size &= ~MEM_FREE_BIT;
+		
+		mem_arena = (char*)arena;
+		mem_arena_end = mem_arena + arena->size;
+		mem_arena_top = arena;
+	}
+	
+	/* Remember where the scope starts, NULL if there's no arena to carve from */
+	mem_scope_mark[mem_scopes++] = (mem_arena != NULL) ? mem_arena_top : NULL;
+	return 0;
+}
+
+void Mem_PopScope(void)
+{
+	if (mem_scopes == 0)
+		return;
+	
+	/* Free what the scope owns from outside its arena, inner scopes' pointers are at the end */
+	while (mem_owns != 0 && mem_own[mem_owns - 1].scope == mem_scopes)
+		Mem_Free(mem_own[--mem_owns].ptr);
 	
+	/* Bring the top down to where the scope started */
+	Mem_Header *mark = mem_scope_mark[--mem_scopes];
+	if (mark != NULL && mark < mem_arena_top)
+	{
+		/* Blocks freed out of order are the only ones still in the free lists */
+		Mem_Header *block;
+		for (block = mark; block != mem_arena_top; block = Mem_BlockNext(block))
+		{
+			if (block->size & MEM_FREE_BIT)
+				Mem_Remove(block);
+			#ifdef MEM_STAT
+			else
+			{
+				mem_used -= Mem_BlockSize(block);
+				mem_tag_used[(block->size & MEM_TAG_MASK) >> MEM_TAG_SHIFT] -= Mem_BlockSize(block);
+			}
+			#endif
+		}
+		Mem_SetTop(mark);
+	}
+	
+	/* Give the arena back once the outermost scope is gone */
+	if (mem_scopes == 0 && mem_arena != NULL)
+	{
+		Mem_Header *arena = (Mem_Header*)mem_arena;
+		mem_arena = mem_arena_end = NULL;
+		Mem_Release(arena);
+	}
+}
+
+int Mem_SetTag(int tag)
+{
+	/* Allocations from here on are counted under this tag */
+	int prev = mem_tag;
+	mem_tag = (tag >= 0 && tag < MEM_TAG_MAX) ? tag : 0;
+	return prev;
+}
+
+void Mem_Retag(void *ptr)
+{
+	#ifdef MEM_STAT
+		/* Move the block from its old tag's count to the current tag's */
+		if (ptr == NULL || !Mem_InHeap(ptr))
+			return;
+		Mem_Header *head = Mem_GetHeader(ptr);
+		size_t size = Mem_BlockSize(head);
+		mem_tag_used[(head->size & MEM_TAG_MASK) >> MEM_TAG_SHIFT] -= size;
+		if ((mem_tag_used[mem_tag] += size) >= mem_tag_max[mem_tag])
+			mem_tag_max[mem_tag] = mem_tag_used[mem_tag];
+		head->size = (head->size & ~MEM_TAG_MASK) | ((size_t)mem_tag << MEM_TAG_SHIFT);
+	#else
+		(void)ptr;
+	#endif
+}
+
+void Mem_CountTag(int tag, ptrdiff_t size)
+{
 	#ifdef MEM_STAT
-		/* Update stats */
-		mem_used -= head->size;
+		/* Only the tag's count moves, the memory isn't the heap's */
+		if (tag < 0 || tag >= MEM_TAG_MAX)
+			tag = 0;
+		if ((mem_tag_used[tag] += size) >= mem_tag_max[tag])
+			mem_tag_max[tag] = mem_tag_used[tag];
+	#else
+		(void)tag;
+		(void)size;
 	#endif
 }
 
@@ -168,10 +751,20 @@ void Mem_Free(void *ptr)
 		if (used != NULL)
 			*used = mem_used;
 		if (size != NULL)
-			*size = mem->size;
+			*size = mem_size;
 		if (max != NULL)
 			*max = mem_max;
 	}
+	
+	void Mem_GetTagStat(int tag, size_t *used, size_t *max)
+	{
+		if (tag < 0 || tag >= MEM_TAG_MAX)
+			tag = 0;
+		if (used != NULL)
+			*used = mem_tag_used[tag];
+		if (max != NULL)
+			*max = mem_tag_max[tag];
+	}
 #endif
 
 #endif /* MEM_IMPLEMENTATION */
@@ -26,6 +26,10 @@
 
 #include "movie.h"
 
+//Menu constants
+#define MENU_CALIBRATE_INTERVAL 600 //Milliseconds between metronome clicks (100 BPM)
+#define MENU_CALIBRATE_TAPS     16  //Taps taken before a latency is worked out
+
 //Menu messages
 static const char *funny_messages[][2] = {
 	{"PSX PORT BY CUCKYDEV", "YOU KNOW IT"},
@@ -124,6 +128,16 @@ static struct
 			boolean swap;
 		} net_op;
 	#endif
+	#ifdef PSXF_PC
+		struct
+		{
+			double last_click;
+			boolean clicked, done;
+			u8 taps, used;
+			s32 deltas[MENU_CALIBRATE_TAPS];
+			s32 latency;
+		} calibrate;
+	#endif
 	} page_state;
 	
 	union
@@ -207,6 +221,52 @@ static const char *Menu_LowerIf(const char *text, boolean lower)
 	return menu_text_buffer;
 }
 
+#ifdef PSXF_PC
+
+static s32 Menu_CalibrateLatency(s32 *deltas, u8 num, u8 *used)
+{
+	//Sort deltas to find the median
+	for (u8 i = 1; i < num; i++)
+		for (u8 j = i; j > 0 && deltas[j - 1] > deltas[j]; j--)
+		{
+			s32 temp = deltas[j];
+			deltas[j] = deltas[j - 1];
+			deltas[j - 1] = temp;
+		}
+	s32 median = deltas[num >> 1];
+	
+	//Get median absolute deviation
+	s32 devs[MENU_CALIBRATE_TAPS];
+	for (u8 i = 0; i < num; i++)
+		devs[i] = (deltas[i] > median) ? (deltas[i] - median) : (median - deltas[i]);
+	for (u8 i = 1; i < num; i++)
+		for (u8 j = i; j > 0 && devs[j - 1] > devs[j]; j--)
+		{
+			s32 temp = devs[j];
+			devs[j] = devs[j - 1];
+			devs[j - 1] = temp;
+		}
+	s32 mad = devs[num >> 1];
+	if (mad < 5)
+		mad = 5;
+	
+	//Average taps within 3 deviations of the median, the rest were mistimed
+	s32 sum = 0;
+	*used = 0;
+	for (u8 i = 0; i < num; i++)
+	{
+		s32 dev = (deltas[i] > median) ? (deltas[i] - median) : (median - deltas[i]);
+		if (dev <= mad * 3)
+		{
+			sum += deltas[i];
+			(*used)++;
+		}
+	}
+	return (*used != 0) ? (sum / *used) : median;
+}
+
+#endif
+
 static void Menu_DrawBack(boolean flash, s32 scroll, u8 r0, u8 g0, u8 b0, u8 r1, u8 g1, u8 b1)
 {
 	RECT back_src = {0, 0, 255, 255};
@@ -291,12 +351,16 @@ static void Menu_DrawWeek(const char *week, s32 x, s32 y)
 //Menu functions
 void Menu_Load(MenuPage page)
 {
+	#ifdef PSXF_PC
+		IO_StatsBegin("Menu_Load");
+	#endif
+	
 	//Load menu assets
 	IO_Data menu_arc = IO_Read("\\MENU\\MENU.ARC;1");
-	Gfx_LoadTex(&menu.tex_back,  Archive_Find(menu_arc, "back.tim"),  0);
-	Gfx_LoadTex(&menu.tex_ng,    Archive_Find(menu_arc, "ng.tim"),    0);
-	Gfx_LoadTex(&menu.tex_story, Archive_Find(menu_arc, "story.tim"), 0);
-	Gfx_LoadTex(&menu.tex_title, Archive_Find(menu_arc, "title.tim"), 0);
+	Gfx_LoadTex(&menu.tex_back,  Archive_FindConst(menu_arc, "back.tim"),  0);
+	Gfx_LoadTex(&menu.tex_ng,    Archive_FindConst(menu_arc, "ng.tim"),    0);
+	Gfx_LoadTex(&menu.tex_story, Archive_FindConst(menu_arc, "story.tim"), 0);
+	Gfx_LoadTex(&menu.tex_title, Archive_FindConst(menu_arc, "title.tim"), 0);
 	Mem_Free(menu_arc);
 	
 	FontData_Load(&menu.font_bold, Font_Bold);
@@ -337,6 +401,10 @@ void Menu_Load(MenuPage page)
 	
 	//Set background colour
 	Gfx_SetClear(0, 0, 0);
+	
+	#ifdef PSXF_PC
+		IO_StatsEnd();
+	#endif
 }
 
 void Menu_Unload(void)
@@ -1042,12 +1110,16 @@ void Menu_Tick(void)
 		case MenuPage_Options:
 		{
 			static const char *gamemode_strs[] = {"NORMAL", "SWAP", "TWO PLAYER"};
+		#ifdef PSXF_PC
+			static const char *rate_strs[] = {"NORMAL", "FAST", "DOUBLE", "HALF", "SLOW"};
+		#endif
 			static const struct
 			{
 				enum
 				{
 					OptType_Boolean,
 					OptType_Enum,
+					OptType_Page,
 				} type;
 				const char *text;
 				void *value;
@@ -1062,12 +1134,20 @@ void Menu_Tick(void)
 						s32 max;
 						const char **strs;
 					} spec_enum;
+					struct
+					{
+						s32 page;
+					} spec_page;
 				} spec;
 			} menu_options[] = {
 				{OptType_Enum,    "GAMEMODE", &stage.mode, {.spec_enum = {COUNT_OF(gamemode_strs), gamemode_strs}}},
 				//{OptType_Boolean, "INTERPOLATION", &stage.expsync},
 				{OptType_Boolean, "GHOST TAP ", &stage.ghost, {.spec_boolean = {0}}},
 				{OptType_Boolean, "DOWNSCROLL", &stage.downscroll, {.spec_boolean = {0}}},
+			#ifdef PSXF_PC
+				{OptType_Enum,    "SPEED", &stage.rate_mode, {.spec_enum = {COUNT_OF(rate_strs), rate_strs}}},
+				{OptType_Page,    "CALIBRATE OFFSET", NULL, {.spec_page = {MenuPage_Calibrate}}},
+			#endif
 			};
 			
 			//Initialize page
@@ -1116,6 +1196,14 @@ void Menu_Tick(void)
 							if (++*((s32*)menu_options[menu.select].value) >= menu_options[menu.select].spec.spec_enum.max)
 								*((s32*)menu_options[menu.select].value) = 0;
 						break;
+					case OptType_Page:
+						if (pad_state.press & (PAD_START | PAD_CROSS))
+						{
+							menu.next_page = menu_options[menu.select].spec.spec_page.page;
+							menu.next_select = 0;
+							Trans_Start();
+						}
+						break;
 				}
 				
 				//Return to main menu if circle is pressed
@@ -1150,6 +1238,9 @@ void Menu_Tick(void)
 					case OptType_Enum:
 						sprintf(text, "%s %s", menu_options[i].text, menu_options[i].spec.spec_enum.strs[*((s32*)menu_options[i].value)]);
 						break;
+					case OptType_Page:
+						strcpy(text, menu_options[i].text);
+						break;
 				}
 				menu.font_bold.draw(&menu.font_bold,
 					Menu_LowerIf(text, menu.select != i),
@@ -1684,13 +1775,139 @@ void Menu_Tick(void)
 			);
 			break;
 		}
+	#endif
+	#ifdef PSXF_PC
+		case MenuPage_Calibrate:
+		{
+			//Initialize page
+			if (menu.page_swap)
+			{
+				//Swap menu music for the metronome
+				Audio_PauseXA();
+				Audio_PlayClick(MENU_CALIBRATE_INTERVAL);
+				
+				double discard[PAD_TAPS];
+				Pad_GetTaps(discard, PAD_TAPS);
+				
+				menu.page_state.calibrate.clicked = false;
+				menu.page_state.calibrate.done = false;
+				menu.page_state.calibrate.taps = 0;
+			}
+			
+			//Get click and tap times
+			double clicks[16];
+			u8 clicks_num = Audio_GetClicks(clicks, COUNT_OF(clicks));
+			if (clicks_num != 0)
+			{
+				menu.page_state.calibrate.last_click = clicks[clicks_num - 1];
+				menu.page_state.calibrate.clicked = true;
+			}
+			
+			double taps[PAD_TAPS];
+			u8 taps_num = Pad_GetTaps(taps, PAD_TAPS);
+			
+			if (!menu.page_state.calibrate.done && menu.page_state.calibrate.clicked)
+			{
+				for (u8 i = 0; i < taps_num && menu.page_state.calibrate.taps < MENU_CALIBRATE_TAPS; i++)
+				{
+					//Measure tap against the nearest click
+					s32 delta = (s32)((taps[i] - menu.page_state.calibrate.last_click) * 1000.0) % MENU_CALIBRATE_INTERVAL;
+					if (delta > MENU_CALIBRATE_INTERVAL / 2)
+						delta -= MENU_CALIBRATE_INTERVAL;
+					if (delta < -MENU_CALIBRATE_INTERVAL / 2)
+						delta += MENU_CALIBRATE_INTERVAL;
+					menu.page_state.calibrate.deltas[menu.page_state.calibrate.taps++] = delta;
+				}
+				
+				//Work out latency once we have enough taps
+				if (menu.page_state.calibrate.taps == MENU_CALIBRATE_TAPS)
+				{
+					menu.page_state.calibrate.latency = Menu_CalibrateLatency(menu.page_state.calibrate.deltas, MENU_CALIBRATE_TAPS, &menu.page_state.calibrate.used);
+					menu.page_state.calibrate.done = true;
+					Audio_PlayClick(0);
+				}
+			}
+			
+			//Handle input
+			if (menu.next_page == menu.page && Trans_Idle())
+			{
+				if (menu.page_state.calibrate.done)
+				{
+					//Save latency if start is pressed
+					if (pad_state.press & PAD_START)
+					{
+						Audio_SetLatency(menu.page_state.calibrate.latency);
+						menu.next_page = MenuPage_Options;
+						menu.next_select = 4; //Calibrate Offset
+						Trans_Start();
+					}
+					
+					//Try again if cross is pressed
+					if (pad_state.press & PAD_CROSS)
+					{
+						menu.page_state.calibrate.clicked = false;
+						menu.page_state.calibrate.done = false;
+						menu.page_state.calibrate.taps = 0;
+						Audio_PlayClick(MENU_CALIBRATE_INTERVAL);
+					}
+				}
+				
+				//Return to options if circle is pressed
+				if (pad_state.press & PAD_CIRCLE)
+				{
+					menu.next_page = MenuPage_Options;
+					menu.next_select = 4; //Calibrate Offset
+					Trans_Start();
+				}
+				
+				//Bring menu music back when leaving
+				if (menu.next_page != menu.page)
+				{
+					Audio_PlayClick(0);
+					Audio_PlayXA_Track(XA_GettinFreaky, 0x40, 0, 1);
+				}
+			}
+			
+			//Draw page label
+			menu.font_bold.draw(&menu.font_bold,
+				"CALIBRATE",
+				16,
+				SCREEN_HEIGHT - 32,
+				FontAlign_Left
+			);
+			
+			//Draw state
+			char text[0x80];
+			if (menu.page_state.calibrate.done)
+			{
+				sprintf(text, "Latency %dms (%d of %d taps used)", (int)menu.page_state.calibrate.latency, menu.page_state.calibrate.used, MENU_CALIBRATE_TAPS);
+				menu.font_arial.draw(&menu.font_arial, text, SCREEN_WIDTH2, SCREEN_HEIGHT2 - 16, FontAlign_Center);
+				menu.font_arial.draw(&menu.font_arial, "Start to save, Cross to retry, Circle to cancel", SCREEN_WIDTH2, SCREEN_HEIGHT2, FontAlign_Center);
+			}
+			else
+			{
+				menu.font_arial.draw(&menu.font_arial, "Tap an arrow key in time with the click", SCREEN_WIDTH2, SCREEN_HEIGHT2 - 16, FontAlign_Center);
+				sprintf(text, "%d / %d (current offset %dms)", menu.page_state.calibrate.taps, MENU_CALIBRATE_TAPS, (int)Audio_GetLatency());
+				menu.font_arial.draw(&menu.font_arial, text, SCREEN_WIDTH2, SCREEN_HEIGHT2, FontAlign_Center);
+			}
+			
+			//Draw background
+			Menu_DrawBack(
+				true,
+				8,
+				253 >> 1, 113 >> 1, 155 >> 1,
+				0, 0, 0
+			);
+			break;
+		}
 	#endif
 		case MenuPage_Stage:
 		{
 			//Unload menu state
 			Menu_Unload();
 			
-			//Load new stage
+			//Load new stage, reading ahead while the loading screen comes in
+			Stage_Prefetch(menu.page_param.stage.id, menu.page_param.stage.diff);
 			LoadScr_Start();
 			Stage_Load(menu.page_param.stage.id, menu.page_param.stage.diff, menu.page_param.stage.story);
 			gameloop = GameLoop_Stage;
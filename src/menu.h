@@ -30,6 +30,9 @@ typedef enum
 		MenuPage_NetLobby,
 		MenuPage_NetInitFail,
 	#endif
+	#ifdef PSXF_PC
+		MenuPage_Calibrate,
+	#endif
 	
 	MenuPage_Stage, //Changes game loop
 } MenuPage;
@@ -9,6 +9,21 @@
 #include "mem.h"
 
 //Object functions
+static void Object_Release(Object *obj)
+{
+	//Give object back to its pool or the heap
+	obj->free(obj);
+	if (obj->pool != NULL)
+	{
+		obj->next = obj->pool->free_list;
+		obj->pool->free_list = obj;
+	}
+	else
+	{
+		Mem_Free(obj);
+	}
+}
+
 void ObjectList_Add(ObjectList *list, Object *obj)
 {
 	//Link to list
@@ -29,8 +44,7 @@ void ObjectList_Remove(ObjectList *list, Object *obj)
 		obj->next->prev = obj->prev;
 	
 	//Free object
-	obj->free(obj);
-	Mem_Free(obj);
+	Object_Release(obj);
 }
 
 void ObjectList_Tick(ObjectList *list)
@@ -57,11 +71,60 @@ void ObjectList_Free(ObjectList *list)
 	{
 		//Free object and iterate on next linked object
 		Object *next = obj->next;
-		obj->free(obj);
-		Mem_Free(obj);
+		Object_Release(obj);
 		obj = next;
 	}
 	
 	//Clear list pointer
 	*list = NULL;
 }
+
+//Object pool functions
+void ObjectPool_Init(ObjectPool *pool, const char *name, size_t size, size_t count)
+{
+	//Allocate objects
+	pool->name = name;
+	pool->size = size;
+	pool->missed = 0;
+	pool->free_list = NULL;
+	if ((pool->data = (u8*)Mem_Alloc(size * count)) == NULL)
+	{
+		printf("[ObjectPool_Init] Failed to allocate %s pool (%d objects)\n", name, (int)count);
+		pool->count = 0;
+		return;
+	}
+	pool->count = count;
+	
+	//Link all objects into the free list
+	for (size_t i = count; i-- > 0;)
+	{
+		Object *obj = (Object*)(pool->data + i * size);
+		obj->next = pool->free_list;
+		pool->free_list = obj;
+	}
+}
+
+void ObjectPool_Quit(ObjectPool *pool)
+{
+	//Objects must have been freed from their lists already
+	Mem_Free(pool->data);
+	pool->data = NULL;
+	pool->free_list = NULL;
+	pool->count = 0;
+}
+
+Object *ObjectPool_Alloc(ObjectPool *pool)
+{
+	//Take object off the free list
+	Object *obj = pool->free_list;
+	if (obj == NULL)
+	{
+		//Report the first time the pool runs dry, the object is just skipped
+		if (pool->missed++ == 0)
+			printf("[ObjectPool_Alloc] %s pool is exhausted (%d objects)\n", (pool->name != NULL) ? pool->name : "Object", (int)pool->count);
+		return NULL;
+	}
+	pool->free_list = obj->next;
+	obj->pool = pool;
+	return obj;
+}
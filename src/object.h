@@ -18,14 +18,31 @@ typedef struct Object
 	//Object functions
 	boolean (*tick)(struct Object*);
 	void (*free)(struct Object*);
+	
+	//Pool the object came from, NULL if it was allocated with Mem_Alloc
+	struct ObjectPool *pool;
 } Object;
 
 typedef Object* ObjectList;
 
+//Object pools, fixed size objects handed out from a free list instead of the heap
+typedef struct ObjectPool
+{
+	const char *name;
+	u8 *data;
+	Object *free_list; //Linked through next
+	size_t size, count;
+	u16 missed; //Allocations that found the pool empty
+} ObjectPool;
+
 //Object functions
 void ObjectList_Add(ObjectList *list, Object *obj);
 void ObjectList_Remove(ObjectList *list, Object *obj);
 void ObjectList_Tick(ObjectList *list);
 void ObjectList_Free(ObjectList *list);
 
+void ObjectPool_Init(ObjectPool *pool, const char *name, size_t size, size_t count);
+void ObjectPool_Quit(ObjectPool *pool);
+Object *ObjectPool_Alloc(ObjectPool *pool);
+
 #endif
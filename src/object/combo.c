@@ -228,8 +228,8 @@ Obj_Combo *Obj_Combo_New(fixed_t x, fixed_t y, u8 hit_type, u16 combo)
 {
 	(void)x;
 	
-	//Allocate new object
-	Obj_Combo *this = (Obj_Combo*)Mem_Alloc(sizeof(Obj_Combo));
+	//Take object from the stage's pool
+	Obj_Combo *this = (Obj_Combo*)ObjectPool_Alloc(&stage.pool_combo);
 	if (this == NULL)
 		return NULL;
 	
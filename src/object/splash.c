@@ -61,8 +61,8 @@ void Obj_Splash_Free(Object *obj)
 
 Obj_Splash *Obj_Splash_New(fixed_t x, fixed_t y, u8 colour)
 {
-	//Allocate new object
-	Obj_Splash *this = (Obj_Splash*)Mem_Alloc(sizeof(Obj_Splash));
+	//Take object from the stage's pool
+	Obj_Splash *this = (Obj_Splash*)ObjectPool_Alloc(&stage.pool_splash);
 	if (this == NULL)
 		return NULL;
 	
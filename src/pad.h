@@ -48,4 +48,10 @@ void Pad_Init(void);
 void Pad_Quit(void);
 void Pad_Update(void);
 
+#ifdef PSXF_PC
+	//Direction presses timestamped by the input callback, in glfwGetTime seconds
+	#define PAD_TAPS 16
+	u8 Pad_GetTaps(double *times, u8 max);
+#endif
+
 #endif
@@ -10,9 +10,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "../io.h"
 #include "../main.h"
+#include "../mem.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+
+#ifdef PSXF_WIN32
+ #include <direct.h>
+#else
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+ #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+#endif
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -46,14 +66,36 @@
  #pragma GCC diagnostic pop
 #endif
 
+//Audio constants
+#define AUDIO_CACHE //Keep decoded and converted MP3s on disk so they don't have to be decoded again
+#define AUDIO_CACHE_DIR "CACHE/" //Next to the ISO directory
+#define AUDIO_CACHE_SIZE ((u64)512 << 20) //Oldest blobs are evicted once the cache grows past this
+
+//#define AUDIO_LOWLATENCY //Ask the backend for small buffers, for rhythm sessions where every millisecond counts
+//#define AUDIO_EXCLUSIVE  //Try to open the device exclusively (WASAPI exclusive, ALSA hw without plugins), falls back to shared
+#define AUDIO_PERIOD_FRAMES 256 //With AUDIO_LOWLATENCY, 0 to let the backend pick
+#define AUDIO_PERIODS       2
+
+#define AUDIO_LATENCY_FILE "LATENCY.TXT" //Next to the ISO directory, written by the calibration page
+
+#define AUDIO_CLICK_MS 30 //Length of a metronome click
+#define AUDIO_CLICKS   16 //Click times kept until the game asks for them
+
+#define RESAMPLE_QUALITY_LOW    0 //8 taps, 64 phases
+#define RESAMPLE_QUALITY_MEDIUM 1 //16 taps, 256 phases
+#define RESAMPLE_QUALITY_HIGH   2 //32 taps, 512 phases
+#define RESAMPLE_QUALITY RESAMPLE_QUALITY_MEDIUM
+#define RESAMPLE_BLOCK   0x1000 //Frames decoded and converted at a time
+
 //XA state
 #define XA_STATE_PLAYING (1 << 0)
 #define XA_STATE_LOOPS   (1 << 1)
 
 static XA_Track xa_track;
-static u8 xa_channel;
 
 static u8 xa_state;
+static size_t xa_pos; //Frames into the track
+static size_t xa_time_pos; //Frames played since the track started, differs from xa_pos when stretched
 
 //Miniaudio
 static ma_context xa_context;
@@ -64,210 +106,1298 @@ static size_t bytes_per_frame;
 
 static double xa_lasttime, xa_interptime, xa_interpstart;
 
+static Audio_Stats xa_stats;
+static double xa_stats_last; //Time of the last callback
+
+//Metronome state
+static s16 xa_click_wave[0x2000];
+static size_t xa_click_len, xa_click_i;
+static u32 xa_click_interval, xa_click_phase; //Frames
+static double xa_clicks[AUDIO_CLICKS];
+static u8 xa_clicks_num;
+
+static s32 xa_latency;
+
+extern char *iso_dir;
+
+static void Audio_GetDataPath(char *path, size_t size, const char *name)
+{
+	//Get path next to the ISO directory
+	path[0] = '\0';
+	if (iso_dir != NULL)
+	{
+		size_t len = strlen(iso_dir);
+		if (len >= 4 && len - 4 + strlen(name) + 1 <= size)
+		{
+			memcpy(path, iso_dir, len - 4); //Cut "ISO/"
+			path[len - 4] = '\0';
+		}
+	}
+	strcat(path, name);
+}
+
+//Mixer state
+#define XA_GAIN_SHIFT 14
+#define XA_GAIN_UNIT  (1 << XA_GAIN_SHIFT)
+#define XA_RAMP_MS    5 //Time taken to fade between the vocal and instrumental streams
+
+static s32 xa_gain[2], xa_gain_target[2]; //XA_GAIN_UNIT is unity
+static s32 xa_gain_step; //Per frame
+
+//Time-stretch state (WSOLA)
+#define STRETCH_HOP_MS  10 //Output produced per segment, segments are twice this long and overlap by half
+#define STRETCH_SEEK_MS 8  //How far either side of the nominal position to search for a similar segment
+
+#define STRETCH_MAX_HOP   2048
+#define STRETCH_MAX_SEEK  2048
+#define STRETCH_MAX_CHANNELS 8
+
+#define XA_RATE_SHIFT 16
+#define XA_RATE_UNIT  (1 << XA_RATE_SHIFT)
+
+static u32 xa_rate; //Playback rate, XA_RATE_UNIT is normal speed
+
+static size_t stretch_hop, stretch_seek; //Frames
+static u64 stretch_pos;    //Nominal position of the next segment, 32.32 frames
+static size_t stretch_ref; //Where the last segment's tail starts, the next segment is matched against this
+static size_t stretch_read, stretch_avail;
+
+static s16 stretch_out[2][STRETCH_MAX_HOP * STRETCH_MAX_CHANNELS];
+static s16 stretch_fade[STRETCH_MAX_HOP]; //Fade in, Q15
+static s16 stretch_mono_ref[STRETCH_MAX_HOP];
+static s16 stretch_mono_seek[STRETCH_MAX_HOP + STRETCH_MAX_SEEK * 2 + 8];
+
 //MP3 decode
 typedef struct
 {
-	boolean playing;
-	unsigned char *data, *datap, *datae;
+	s16 *data;
+	size_t frames;
+	
+	//Set if data points into a mapped cache blob rather than a malloc'd buffer
+	void *map;
+	size_t map_size;
 } MP3Decode;
 
 MP3Decode xa_mp3[2];
 
+//Prefetch state
+#define XA_PREFETCH_IDLE    0
+#define XA_PREFETCH_PENDING 1 //Being decoded by the prefetch thread
+#define XA_PREFETCH_READY   2 //Decoded and waiting to be handed off
+
+static ma_thread xa_prefetch_thread;
+static ma_semaphore xa_prefetch_sem;
+static ma_event xa_prefetch_done;
+static c89atomic_uint32 xa_prefetch_state;
+static boolean xa_prefetch_quit;
+
+static XA_Track xa_prefetch_track;
+static MP3Decode xa_prefetch_mp3[2];
+
+#define AUDIO_FAIL_MAX 0x80
+static char xa_prefetch_fail[AUDIO_FAIL_MAX]; //Prefetch thread can't ErrorLock itself, Audio_SeekXA_Track reports for it
+
 extern FILE *IO_OpenFile(CdlFILE *file);
 
-static boolean MP3Decode_Decode(MP3Decode *this, CdlFILE *file)
+#ifdef AUDIO_CACHE
+
+//PCM cache
+#define AUDIO_CACHE_MAGIC   0x4D435058 //XPCM
+#define AUDIO_CACHE_VERSION 2
+
+typedef struct
 {
-	//Open file and read contents
-	FILE *fp = IO_OpenFile(file);
+	u32 magic, version;
+	u32 format, channels, sample_rate;
+	u32 quality;
+	u64 frames;
+} AudioCache_Header;
+
+static char cache_dir[0x200];
+
+static u64 AudioCache_Hash(u64 hash, const unsigned char *data, size_t size)
+{
+	//FNV-1a, start with 0xCBF29CE484222325
+	for (const unsigned char *datae = data + size; data < datae; data++)
+	{
+		hash ^= *data;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static void AudioCache_Init(void)
+{
+	//Get cache directory next to the ISO directory
+	Audio_GetDataPath(cache_dir, sizeof(cache_dir), AUDIO_CACHE_DIR);
+	
+	//Make sure cache directory exists
+	#ifdef PSXF_WIN32
+		_mkdir(cache_dir);
+	#else
+		mkdir(cache_dir, 0777);
+	#endif
+}
+
+static void AudioCache_GetPath(char *path, u64 hash, const char *ext)
+{
+	sprintf(path, "%s%016llX_%d_%u_%u%s", cache_dir, (unsigned long long)hash, (int)xa_device.playback.format, (unsigned)xa_device.playback.channels, (unsigned)xa_device.sampleRate, ext);
+}
+
+static void AudioCache_Unmap(void *map, size_t map_size)
+{
+	#ifdef PSXF_WIN32
+		(void)map_size;
+		UnmapViewOfFile(map);
+	#else
+		munmap(map, map_size);
+	#endif
+}
+
+static void *AudioCache_MapFile(const char *path, size_t *size)
+{
+	#ifdef PSXF_WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return NULL;
+		
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(AudioCache_Header))
+		{
+			CloseHandle(file);
+			return NULL;
+		}
+		
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (mapping == NULL)
+			return NULL;
+		
+		void *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); //The view keeps the mapping alive
+		*size = (size_t)file_size.QuadPart;
+		return map;
+	#else
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return NULL;
+		
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(AudioCache_Header))
+		{
+			close(fd);
+			return NULL;
+		}
+		
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); //The mapping keeps the file alive
+		if (map == MAP_FAILED)
+			return NULL;
+		*size = st.st_size;
+		return map;
+	#endif
+}
+
+static boolean AudioCache_Map(MP3Decode *this, u64 hash)
+{
+	//Map cached blob
+	char path[0x240];
+	AudioCache_GetPath(path, hash, ".pcm");
+	
+	size_t map_size;
+	void *map = AudioCache_MapFile(path, &map_size);
+	if (map == NULL)
+		return true;
+	
+	//Validate header against the device we're playing to
+	const AudioCache_Header *header = (const AudioCache_Header*)map;
+	if (header->magic != AUDIO_CACHE_MAGIC ||
+	    header->version != AUDIO_CACHE_VERSION ||
+	    header->format != (u32)xa_device.playback.format ||
+	    header->channels != xa_device.playback.channels ||
+	    header->sample_rate != xa_device.sampleRate ||
+	    header->quality != RESAMPLE_QUALITY ||
+	    map_size != sizeof(AudioCache_Header) + header->frames * bytes_per_frame)
+	{
+		//Stale or truncated, throw it away
+		AudioCache_Unmap(map, map_size);
+		remove(path);
+		return true;
+	}
+	
+	//Use mapped data
+	this->map = map;
+	this->map_size = map_size;
+	this->data = (s16*)((unsigned char*)map + sizeof(AudioCache_Header));
+	this->frames = header->frames;
+	
+	//Touch the blob so eviction sees it as recently used
+	utime(path, NULL);
+	return false;
+}
+
+static void AudioCache_Evict(void)
+{
+	//Get cache contents
+	typedef struct
+	{
+		char name[64];
+		u64 size;
+		time_t time;
+	} AudioCache_Entry;
+	
+	DIR *dir = opendir(cache_dir);
+	if (dir == NULL)
+		return;
+	
+	AudioCache_Entry *entries = NULL;
+	size_t entries_num = 0, entries_cap = 0;
+	u64 total = 0;
+	
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL)
+	{
+		//Only consider our blobs
+		size_t len = strlen(ent->d_name);
+		if (len < 4 || len >= sizeof(entries->name) || strcmp(ent->d_name + len - 4, ".pcm"))
+			continue;
+		
+		char path[0x240];
+		if ((size_t)snprintf(path, sizeof(path), "%s%s", cache_dir, ent->d_name) >= sizeof(path))
+			continue;
+		struct stat st;
+		if (stat(path, &st) != 0)
+			continue;
+		
+		//Push entry
+		if (entries_num == entries_cap)
+		{
+			size_t next_cap = entries_cap ? (entries_cap << 1) : 32;
+			AudioCache_Entry *next = realloc(entries, next_cap * sizeof(AudioCache_Entry));
+			if (next == NULL)
+				break;
+			entries = next;
+			entries_cap = next_cap;
+		}
+		strcpy(entries[entries_num].name, ent->d_name);
+		entries[entries_num].size = st.st_size;
+		entries[entries_num].time = st.st_mtime;
+		entries_num++;
+		total += st.st_size;
+	}
+	closedir(dir);
+	
+	//Remove least recently used blobs until we're under the cap
+	while (total > AUDIO_CACHE_SIZE)
+	{
+		AudioCache_Entry *oldest = NULL;
+		for (size_t i = 0; i < entries_num; i++)
+			if (entries[i].size != 0 && (oldest == NULL || entries[i].time < oldest->time))
+				oldest = &entries[i];
+		if (oldest == NULL)
+			break;
+		
+		char path[0x240];
+		if ((size_t)snprintf(path, sizeof(path), "%s%s", cache_dir, oldest->name) < sizeof(path))
+			remove(path);
+		total -= oldest->size;
+		oldest->size = 0;
+	}
+	
+	free(entries);
+}
+
+static FILE *AudioCache_Begin(u64 hash, u64 frames)
+{
+	//Write to a temporary file first so a partial blob is never picked up
+	char temp_path[0x240];
+	AudioCache_GetPath(temp_path, hash, ".tmp");
+	
+	FILE *fp = fopen(temp_path, "wb");
 	if (fp == NULL)
+		return NULL;
+	
+	AudioCache_Header header;
+	header.magic = AUDIO_CACHE_MAGIC;
+	header.version = AUDIO_CACHE_VERSION;
+	header.format = xa_device.playback.format;
+	header.channels = xa_device.playback.channels;
+	header.sample_rate = xa_device.sampleRate;
+	header.quality = RESAMPLE_QUALITY;
+	header.frames = frames;
+	
+	if (fwrite(&header, sizeof(header), 1, fp) != 1)
+	{
+		fclose(fp);
+		remove(temp_path);
+		return NULL;
+	}
+	return fp;
+}
+
+static boolean AudioCache_End(FILE *fp, u64 hash, boolean fail)
+{
+	char path[0x240], temp_path[0x240];
+	AudioCache_GetPath(path, hash, ".pcm");
+	AudioCache_GetPath(temp_path, hash, ".tmp");
+	
+	if (fclose(fp) != 0)
+		fail = true;
+	if (fail)
+	{
+		remove(temp_path);
 		return true;
+	}
 	
-	fseek(fp, 0, SEEK_END);
-	size_t size = ftell(fp);
-	unsigned char *data = malloc(size);
-	if (data == NULL)
+	//Move blob into place
+	remove(path);
+	if (rename(temp_path, path) != 0)
 	{
-		sprintf(error_msg, "[MP3Decode_Decode] Failed to allocate \"%s\" buffer (size 0x%zX)", file->path, size);
-		ErrorLock();
+		remove(temp_path);
 		return true;
 	}
-	fseek(fp, 0, SEEK_SET);
-	if (fread(data, size, 1, fp) != 1)
+	
+	//Keep cache under its size cap
+	AudioCache_Evict();
+	return false;
+}
+
+#endif
+
+static void MP3Decode_Free(MP3Decode *this)
+{
+	//Release data
+	#ifdef AUDIO_CACHE
+		if (this->map != NULL)
+			AudioCache_Unmap(this->map, this->map_size);
+		else
+	#endif
+			free(this->data);
+	
+	this->data = NULL;
+	this->frames = 0;
+	this->map = NULL;
+}
+
+static void MP3Decode_Count(const MP3Decode *this, ptrdiff_t sign)
+{
+	//Count a track's buffers under the audio tag, only from the main thread while it's in xa_mp3
+	for (int i = 0; i < 2; i++)
+		if (this[i].map == NULL && this[i].data != NULL)
+			Mem_CountTag(MemTag_Audio, sign * (ptrdiff_t)(this[i].frames * bytes_per_frame));
+}
+
+//Polyphase resampler
+#if RESAMPLE_QUALITY == RESAMPLE_QUALITY_LOW
+ #define RESAMPLE_TAPS       8
+ #define RESAMPLE_PHASE_BITS 6
+#elif RESAMPLE_QUALITY == RESAMPLE_QUALITY_MEDIUM
+ #define RESAMPLE_TAPS       16
+ #define RESAMPLE_PHASE_BITS 8
+#else
+ #define RESAMPLE_TAPS       32
+ #define RESAMPLE_PHASE_BITS 9
+#endif
+#define RESAMPLE_PHASES     (1 << RESAMPLE_PHASE_BITS)
+#define RESAMPLE_COEF_SHIFT 14
+#define RESAMPLE_HIST       (RESAMPLE_BLOCK + RESAMPLE_TAPS) //Planar frames kept per channel
+
+typedef struct
+{
+	drmp3 *mp3;
+	u32 in_channels, out_channels;
+	boolean passthrough, eof;
+	
+	//Input position in 32.32 fixed point, relative to the start of hist
+	u64 pos, step;
+	
+	//Working set, allocated once per decode regardless of song length
+	s16 *coef;  //[RESAMPLE_PHASES][RESAMPLE_TAPS]
+	s16 *hist;  //[out_channels][RESAMPLE_HIST]
+	s16 *block; //[RESAMPLE_BLOCK][in_channels]
+	s16 *out;   //[RESAMPLE_BLOCK][out_channels], staging for the cache file
+	size_t hist_len;
+} Resampler;
+
+static void Resampler_GenCoef(s16 *coef, u32 in_rate, u32 out_rate)
+{
+	//Windowed sinc, cutoff lowered when downsampling so we don't alias
+	double cutoff = (out_rate < in_rate) ? ((double)out_rate / in_rate) : 1.0;
+	cutoff *= 0.95;
+	
+	for (int p = 0; p < RESAMPLE_PHASES; p++)
 	{
-		sprintf(error_msg, "[MP3Decode_Decode] Failed to read \"%s\"", file->path);
-		ErrorLock();
+		double frac = (double)p / RESAMPLE_PHASES;
+		double h[RESAMPLE_TAPS], sum = 0.0;
+		
+		for (int k = 0; k < RESAMPLE_TAPS; k++)
+		{
+			//Distance from the output sample, tap (RESAMPLE_TAPS / 2 - 1) is the sample at or before it
+			double x = (k - (RESAMPLE_TAPS / 2 - 1)) - frac;
+			double sinc = (x == 0.0) ? 1.0 : (sin(MA_PI_D * cutoff * x) / (MA_PI_D * cutoff * x));
+			
+			//Blackman window
+			double w = (x + RESAMPLE_TAPS / 2) / RESAMPLE_TAPS;
+			double window = (w <= 0.0 || w >= 1.0) ? 0.0 : (0.42 - 0.5 * cos(2.0 * MA_PI_D * w) + 0.08 * cos(4.0 * MA_PI_D * w));
+			
+			h[k] = sinc * window;
+			sum += h[k];
+		}
+		
+		//Normalize for unity gain at DC
+		for (int k = 0; k < RESAMPLE_TAPS; k++)
+			*coef++ = (s16)lrint(h[k] / sum * (1 << RESAMPLE_COEF_SHIFT));
+	}
+}
+
+static s32 Resampler_Dot(const s16 *x, const s16 *h)
+{
+	//RESAMPLE_TAPS is always a multiple of 8
+#if defined(__SSE2__) || defined(_M_X64)
+	__m128i acc = _mm_setzero_si128();
+	for (int k = 0; k < RESAMPLE_TAPS; k += 8)
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(x + k)), _mm_loadu_si128((const __m128i*)(h + k))));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	int32x4_t acc = vdupq_n_s32(0);
+	for (int k = 0; k < RESAMPLE_TAPS; k += 8)
+	{
+		int16x8_t vx = vld1q_s16(x + k);
+		int16x8_t vh = vld1q_s16(h + k);
+		acc = vmlal_s16(acc, vget_low_s16(vx), vget_low_s16(vh));
+		acc = vmlal_s16(acc, vget_high_s16(vx), vget_high_s16(vh));
+	}
+	int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#else
+	s32 acc = 0;
+	for (int k = 0; k < RESAMPLE_TAPS; k++)
+		acc += (s32)x[k] * h[k];
+	return acc;
+#endif
+}
+
+static boolean Resampler_Init(Resampler *this, drmp3 *mp3)
+{
+	this->mp3 = mp3;
+	this->in_channels = mp3->channels;
+	this->out_channels = xa_device.playback.channels;
+	this->passthrough = mp3->sampleRate == xa_device.sampleRate;
+	this->eof = false;
+	
+	this->step = ((u64)mp3->sampleRate << 32) / xa_device.sampleRate;
+	this->pos = 0;
+	
+	//Allocate working set
+	size_t coef_size = this->passthrough ? 0 : (RESAMPLE_PHASES * RESAMPLE_TAPS);
+	size_t hist_size = (size_t)this->out_channels * RESAMPLE_HIST;
+	size_t block_size = (size_t)this->in_channels * RESAMPLE_BLOCK;
+	size_t out_size = (size_t)this->out_channels * RESAMPLE_BLOCK;
+	if ((this->coef = malloc((coef_size + hist_size + block_size + out_size) * sizeof(s16))) == NULL)
 		return true;
+	this->hist = this->coef + coef_size;
+	this->block = this->hist + hist_size;
+	this->out = this->block + block_size;
+	
+	if (!this->passthrough)
+	{
+		Resampler_GenCoef(this->coef, mp3->sampleRate, xa_device.sampleRate);
+		
+		//Pad history so the first output sample is centred on the first input sample
+		this->hist_len = RESAMPLE_TAPS / 2 - 1;
+		for (u32 c = 0; c < this->out_channels; c++)
+			memset(this->hist + c * RESAMPLE_HIST, 0, this->hist_len * sizeof(s16));
 	}
-	fclose(fp);
+	else
+	{
+		this->hist_len = 0;
+	}
+	return false;
+}
+
+static void Resampler_Free(Resampler *this)
+{
+	free(this->coef);
+}
+
+static size_t Resampler_Fill(Resampler *this)
+{
+	//Decode next block and remap it into planar history
+	size_t space = RESAMPLE_HIST - this->hist_len;
+	if (space > RESAMPLE_BLOCK)
+		space = RESAMPLE_BLOCK;
+	
+	size_t frames = 0;
+	if (!this->eof)
+	{
+		frames = drmp3_read_pcm_frames_s16(this->mp3, space, this->block);
+		if (frames == 0)
+		{
+			//Flush the filter with silence
+			this->eof = true;
+			frames = this->passthrough ? 0 : (RESAMPLE_TAPS / 2);
+			if (frames > space)
+				frames = space;
+			memset(this->block, 0, frames * this->in_channels * sizeof(s16));
+		}
+	}
+	
+	u32 in_channels = this->in_channels;
+	for (u32 c = 0; c < this->out_channels; c++)
+	{
+		s16 *dst = this->hist + c * RESAMPLE_HIST + this->hist_len;
+		const s16 *src = this->block;
+		
+		if (in_channels == 1 || c < in_channels)
+		{
+			//Copy matching channel, mono goes to every channel
+			u32 ci = (in_channels == 1) ? 0 : c;
+			if (this->out_channels == 1 && in_channels == 2)
+			{
+				//Downmix stereo
+				for (size_t i = 0; i < frames; i++, src += 2)
+					*dst++ = (s16)(((s32)src[0] + src[1]) >> 1);
+			}
+			else
+			{
+				for (size_t i = 0; i < frames; i++, src += in_channels)
+					*dst++ = src[ci];
+			}
+		}
+		else
+		{
+			//Leave extra channels silent
+			memset(dst, 0, frames * sizeof(s16));
+		}
+	}
+	
+	this->hist_len += frames;
+	return frames;
+}
+
+static size_t Resampler_Process(Resampler *this, s16 *out, size_t frames)
+{
+	u32 channels = this->out_channels;
+	size_t done = 0;
+	
+	while (done < frames)
+	{
+		//Make sure the filter has enough input for the next output sample
+		size_t base = (size_t)(this->pos >> 32);
+		size_t need = base + (this->passthrough ? 1 : RESAMPLE_TAPS);
+		if (need > this->hist_len)
+		{
+			//Drop consumed input
+			size_t drop = (base < this->hist_len) ? base : this->hist_len;
+			if (drop != 0)
+			{
+				for (u32 c = 0; c < channels; c++)
+					memmove(this->hist + c * RESAMPLE_HIST, this->hist + c * RESAMPLE_HIST + drop, (this->hist_len - drop) * sizeof(s16));
+				this->hist_len -= drop;
+				this->pos -= (u64)drop << 32;
+			}
+			
+			if (Resampler_Fill(this) == 0)
+				break;
+			continue;
+		}
+		
+		//Produce as many frames as the current history allows
+		if (this->passthrough)
+		{
+			size_t todo = this->hist_len - base;
+			if (todo > frames - done)
+				todo = frames - done;
+			for (u32 c = 0; c < channels; c++)
+			{
+				const s16 *src = this->hist + c * RESAMPLE_HIST + base;
+				s16 *dst = out + done * channels + c;
+				for (size_t i = 0; i < todo; i++, dst += channels)
+					*dst = src[i];
+			}
+			done += todo;
+			this->pos += (u64)todo << 32;
+		}
+		else
+		{
+			s16 *dst = out + done * channels;
+			while (done < frames)
+			{
+				base = (size_t)(this->pos >> 32);
+				if (base + RESAMPLE_TAPS > this->hist_len)
+					break;
+				
+				const s16 *h = this->coef + ((u32)this->pos >> (32 - RESAMPLE_PHASE_BITS)) * RESAMPLE_TAPS;
+				for (u32 c = 0; c < channels; c++)
+				{
+					s32 v = (Resampler_Dot(this->hist + c * RESAMPLE_HIST + base, h) + (1 << (RESAMPLE_COEF_SHIFT - 1))) >> RESAMPLE_COEF_SHIFT;
+					if (v > 0x7FFF)
+						v = 0x7FFF;
+					if (v < -0x8000)
+						v = -0x8000;
+					*dst++ = (s16)v;
+				}
+				done++;
+				this->pos += this->step;
+			}
+		}
+	}
+	return done;
+}
+
+//MP3 file callbacks
+static size_t MP3Decode_OnRead(void *user, void *buffer, size_t bytes)
+{
+	return fread(buffer, 1, bytes, (FILE*)user);
+}
+
+static drmp3_bool32 MP3Decode_OnSeek(void *user, int offset, drmp3_seek_origin origin)
+{
+	return fseek((FILE*)user, offset, (origin == drmp3_seek_origin_start) ? SEEK_SET : SEEK_CUR) == 0;
+}
+
+static boolean MP3Decode_Convert(drmp3 *mp3, u64 frames, s16 *data, FILE *out_fp)
+{
+	//Stream the MP3 through the resampler, a block at a time, into either memory or the cache file
+	//Everything here is per call, the prefetch thread may be converting another song at the same time
+	Resampler resampler;
+	if (Resampler_Init(&resampler, mp3))
+		return true;
+	
+	boolean fail = false;
+	while (frames != 0)
+	{
+		size_t todo = (frames > RESAMPLE_BLOCK) ? RESAMPLE_BLOCK : (size_t)frames;
+		s16 *dst = (out_fp != NULL) ? resampler.out : data;
+		size_t done = Resampler_Process(&resampler, dst, todo);
+		
+		//The decoder may come up short of its own frame count, pad with silence
+		if (done < todo)
+			memset(dst + done * xa_device.playback.channels, 0, (todo - done) * bytes_per_frame);
+		
+		if (out_fp != NULL)
+		{
+			if (fwrite(resampler.out, todo * bytes_per_frame, 1, out_fp) != 1)
+			{
+				fail = true;
+				break;
+			}
+		}
+		else
+		{
+			data += todo * xa_device.playback.channels;
+		}
+		frames -= todo;
+	}
+	
+	Resampler_Free(&resampler);
+	return fail;
+}
+
+static boolean MP3Decode_Decode(MP3Decode *this, CdlFILE *file, char *fail)
+{
+	//Failures are written to fail rather than locking up, this runs on the prefetch thread too
+	this->map = NULL;
+	
+	//Open file
+	FILE *fp = IO_OpenFile(file);
+	if (fp == NULL)
+	{
+		snprintf(fail, AUDIO_FAIL_MAX, "[MP3Decode_Decode] Failed to open \"%s\"", file->path);
+		return true;
+	}
+	
+	#ifdef AUDIO_CACHE
+		//Use cached PCM if this MP3 has already been decoded for this device
+		u64 hash = 0xCBF29CE484222325ULL;
+		unsigned char hash_block[0x4000];
+		size_t hash_read;
+		while ((hash_read = fread(hash_block, 1, sizeof(hash_block), fp)) != 0)
+			hash = AudioCache_Hash(hash, hash_block, hash_read);
+		if (!AudioCache_Map(this, hash))
+		{
+			fclose(fp);
+			return false;
+		}
+		fseek(fp, 0, SEEK_SET);
+	#endif
 	
-	//Prepare dr_mp3 decoding
+	//Prepare dr_mp3 decoding, reading straight from the file
 	drmp3 drmp3_instance;
-	if (!drmp3_init_memory(&drmp3_instance, data, size, NULL))
+	if (!drmp3_init(&drmp3_instance, MP3Decode_OnRead, MP3Decode_OnSeek, fp, NULL))
 	{
-		sprintf(error_msg, "[MP3Decode_Decode] Failed to initialize dr_mp3 instance");
-		ErrorLock();
+		fclose(fp);
+		snprintf(fail, AUDIO_FAIL_MAX, "[MP3Decode_Decode] Failed to initialize dr_mp3 instance for \"%s\"", file->path);
 		return true;
 	}
 	
+	//Get converted length, this scans the file then seeks back to the start
 	drmp3_uint64 decoded_frames = drmp3_get_pcm_frame_count(&drmp3_instance);
-	drmp3_uint32 decoded_channels = drmp3_instance.channels;
-	drmp3_uint32 decoded_samplerate = drmp3_instance.sampleRate;
+	u64 output_frames = (decoded_frames * xa_device.sampleRate + drmp3_instance.sampleRate - 1) / drmp3_instance.sampleRate;
 	
-	//Decode entire file to buffer
-	short *decoded = malloc(decoded_frames * decoded_channels * sizeof(short));
+	#ifdef AUDIO_CACHE
+		//Convert straight into the cache, then map it back
+		FILE *cache_fp = AudioCache_Begin(hash, output_frames);
+		if (cache_fp != NULL)
+		{
+			boolean fail = MP3Decode_Convert(&drmp3_instance, output_frames, NULL, cache_fp);
+			if (!AudioCache_End(cache_fp, hash, fail) && !AudioCache_Map(this, hash))
+			{
+				drmp3_uninit(&drmp3_instance);
+				fclose(fp);
+				return false;
+			}
+			
+			//Couldn't use the cache, convert again into memory
+			drmp3_seek_to_pcm_frame(&drmp3_instance, 0);
+		}
+	#endif
 	
-	drmp3_read_pcm_frames_s16(&drmp3_instance, decoded_frames, decoded);
-	drmp3_uninit(&drmp3_instance);
-	free(data);
-
-	//Convert buffer to output format
-	ma_uint64 output_frames = ma_convert_frames(NULL, 0, xa_device.playback.format, xa_device.playback.channels, xa_device.sampleRate, decoded, decoded_frames, ma_format_s16, decoded_channels, decoded_samplerate);
-
+	//Convert into memory
 	this->data = malloc(output_frames * bytes_per_frame);
-
+	
 	if (this->data == NULL)
 	{
-		sprintf(error_msg, "[MP3Decode_Decode] Failed to allocate converted audio buffer");
-		ErrorLock();
+		drmp3_uninit(&drmp3_instance);
+		fclose(fp);
+		snprintf(fail, AUDIO_FAIL_MAX, "[MP3Decode_Decode] Failed to allocate converted audio buffer");
 		return true;
 	}
-
-	output_frames = ma_convert_frames(this->data, output_frames, xa_device.playback.format, xa_device.playback.channels, xa_device.sampleRate, decoded, decoded_frames, ma_format_s16, decoded_channels, decoded_samplerate);
-	free(decoded);
 	
-	this->datap = this->data;
-	this->datae = this->data + (output_frames * bytes_per_frame);
+	if (MP3Decode_Convert(&drmp3_instance, output_frames, this->data, NULL))
+	{
+		free(this->data);
+		this->data = NULL;
+		drmp3_uninit(&drmp3_instance);
+		fclose(fp);
+		snprintf(fail, AUDIO_FAIL_MAX, "[MP3Decode_Decode] Failed to allocate resampler");
+		return true;
+	}
+	drmp3_uninit(&drmp3_instance);
+	fclose(fp);
 	
+	this->frames = output_frames;
 	return false;
 }
 
-static size_t MP3Decode_Copy(MP3Decode *this, unsigned char *stream, size_t bytes_to_do)
+//Mixer kernels
+static void Mix_Ramp(s16 *out, const s16 *a, const s16 *b, size_t frames)
 {
-	//Make sure data exists
-	if (this->data == NULL || this->datap == NULL || this->datae == NULL)
+	//Step both gains towards their targets every frame
+	u32 channels = xa_device.playback.channels;
+	for (; frames != 0; frames--)
 	{
-		memset(stream, 0, bytes_to_do);
-		return bytes_to_do;
+		for (int i = 0; i < 2; i++)
+		{
+			if (xa_gain[i] < xa_gain_target[i])
+			{
+				if ((xa_gain[i] += xa_gain_step) > xa_gain_target[i])
+					xa_gain[i] = xa_gain_target[i];
+			}
+			else if (xa_gain[i] > xa_gain_target[i])
+			{
+				if ((xa_gain[i] -= xa_gain_step) < xa_gain_target[i])
+					xa_gain[i] = xa_gain_target[i];
+			}
+		}
+		
+		for (u32 i = 0; i < channels; i++)
+		{
+			s32 v = ((s32)*a++ * xa_gain[0] + (s32)*b++ * xa_gain[1]) >> XA_GAIN_SHIFT;
+			if (v > 0x7FFF)
+				v = 0x7FFF;
+			if (v < -0x8000)
+				v = -0x8000;
+			*out++ = (s16)v;
+		}
 	}
+}
 
-	//Calculate bytes left
-	size_t bytes_done = bytes_to_do;
-	size_t bytes_left = this->datae - this->datap;
-	if (bytes_done > bytes_left)
-		bytes_done = bytes_left;
+static void Mix_Steady(s16 *out, const s16 *a, const s16 *b, size_t samples, s16 ga, s16 gb)
+{
+	//Mix 8 samples at a time
+#if defined(__SSE2__) || defined(_M_X64)
+	__m128i gains = _mm_set1_epi32((u16)ga | ((u32)(u16)gb << 16));
+	for (; samples >= 8; samples -= 8, a += 8, b += 8, out += 8)
+	{
+		//Interleave a and b so madd gives us a * ga + b * gb per sample
+		__m128i va = _mm_loadu_si128((const __m128i*)a);
+		__m128i vb = _mm_loadu_si128((const __m128i*)b);
+		__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(va, vb), gains);
+		__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(va, vb), gains);
+		lo = _mm_srai_epi32(lo, XA_GAIN_SHIFT);
+		hi = _mm_srai_epi32(hi, XA_GAIN_SHIFT);
+		_mm_storeu_si128((__m128i*)out, _mm_packs_epi32(lo, hi));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	int16x4_t vga = vdup_n_s16(ga);
+	int16x4_t vgb = vdup_n_s16(gb);
+	for (; samples >= 8; samples -= 8, a += 8, b += 8, out += 8)
+	{
+		int16x8_t va = vld1q_s16(a);
+		int16x8_t vb = vld1q_s16(b);
+		int32x4_t lo = vmlal_s16(vmull_s16(vget_low_s16(va), vga), vget_low_s16(vb), vgb);
+		int32x4_t hi = vmlal_s16(vmull_s16(vget_high_s16(va), vga), vget_high_s16(vb), vgb);
+		vst1q_s16(out, vcombine_s16(vqshrn_n_s32(lo, XA_GAIN_SHIFT), vqshrn_n_s32(hi, XA_GAIN_SHIFT)));
+	}
+#endif
+	
+	//Mix remaining samples
+	for (; samples != 0; samples--)
+	{
+		s32 v = ((s32)*a++ * ga + (s32)*b++ * gb) >> XA_GAIN_SHIFT;
+		if (v > 0x7FFF)
+			v = 0x7FFF;
+		if (v < -0x8000)
+			v = -0x8000;
+		*out++ = (s16)v;
+	}
+}
+
+static void Mix_Frames(s16 *out, const s16 *a, const s16 *b, size_t frames)
+{
+	u32 channels = xa_device.playback.channels;
+	
+	//Ramp gains if they haven't reached their targets yet
+	if (xa_gain[0] != xa_gain_target[0] || xa_gain[1] != xa_gain_target[1])
+	{
+		size_t ramp_frames = 0;
+		for (int i = 0; i < 2; i++)
+		{
+			s32 diff = xa_gain_target[i] - xa_gain[i];
+			if (diff < 0)
+				diff = -diff;
+			size_t need = (diff + xa_gain_step - 1) / xa_gain_step;
+			if (need > ramp_frames)
+				ramp_frames = need;
+		}
+		if (ramp_frames > frames)
+			ramp_frames = frames;
+		
+		Mix_Ramp(out, a, b, ramp_frames);
+		out += ramp_frames * channels;
+		a += ramp_frames * channels;
+		b += ramp_frames * channels;
+		frames -= ramp_frames;
+	}
+	
+	//Mix the rest with constant gains
+	if (frames == 0)
+		return;
+	if (xa_gain[0] == XA_GAIN_UNIT && xa_gain[1] == 0)
+		memcpy(out, a, frames * bytes_per_frame);
+	else if (xa_gain[0] == 0 && xa_gain[1] == XA_GAIN_UNIT)
+		memcpy(out, b, frames * bytes_per_frame);
+	else
+		Mix_Steady(out, a, b, frames * channels, xa_gain[0], xa_gain[1]);
+}
 
-	//Copy data
-	memcpy(stream, this->datap, bytes_done);
+//XA files and tracks
+static CdlFILE xa_files[XA_TrackMax][2]; //Vocal and instrumental for split tracks
 
-	//Advance pointer
-	this->datap += bytes_done;
+#include "../audio_def.h"
 
-	return bytes_done;
+//Time-stretch
+static s32 Stretch_Dot(const s16 *a, const s16 *b, size_t n)
+{
+	//n is always a multiple of 8
+#if defined(__SSE2__) || defined(_M_X64)
+	__m128i acc = _mm_setzero_si128();
+	for (size_t i = 0; i < n; i += 8)
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	int32x4_t acc = vdupq_n_s32(0);
+	for (size_t i = 0; i < n; i += 8)
+	{
+		int16x8_t va = vld1q_s16(a + i);
+		int16x8_t vb = vld1q_s16(b + i);
+		acc = vmlal_s16(acc, vget_low_s16(va), vget_low_s16(vb));
+		acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+	}
+	int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#else
+	s32 acc = 0;
+	for (size_t i = 0; i < n; i++)
+		acc += (s32)a[i] * b[i];
+	return acc;
+#endif
 }
 
-static void MP3Decode_Skip(MP3Decode *this, size_t bytes_to_skip)
+static void Stretch_Mono(s16 *out, size_t start, size_t frames)
 {
-	//Make sure data exists
-	if (this->data == NULL || this->datap == NULL || this->datae == NULL)
-		return;
+	//Downmix the first stream for matching, scaled so a segment's dot product can't overflow
+	const MP3Decode *mp3 = &xa_mp3[0];
+	u32 channels = xa_device.playback.channels;
+	for (size_t i = 0; i < frames; i++)
+	{
+		s32 sum = 0;
+		if (start + i < mp3->frames)
+		{
+			const s16 *src = mp3->data + (start + i) * channels;
+			for (u32 c = 0; c < channels; c++)
+				sum += src[c];
+			sum /= (s32)channels;
+		}
+		out[i] = (s16)(sum >> 5);
+	}
+}
+
+static void Stretch_Reset(void)
+{
+	stretch_pos = 0;
+	stretch_ref = 0;
+	stretch_read = stretch_avail = 0;
+}
+
+static void Stretch_Step(void)
+{
+	u32 channels = xa_device.playback.channels;
+	size_t hop = stretch_hop;
+	
+	//Get search range around the nominal position
+	size_t nominal = (size_t)(stretch_pos >> 32);
+	size_t lo = (nominal > stretch_seek) ? (nominal - stretch_seek) : 0;
+	size_t range = nominal + stretch_seek - lo;
+	
+	//Find the segment that best continues the last one, coarse then fine
+	Stretch_Mono(stretch_mono_ref, stretch_ref, hop);
+	Stretch_Mono(stretch_mono_seek, lo, range + hop + 8);
 	
-	//Skip
-	this->datap += bytes_to_skip;
-	if (this->datap >= this->datae)
-		this->datap = this->datae;
+	size_t best = nominal - lo;
+	s32 best_corr = Stretch_Dot(stretch_mono_seek + best, stretch_mono_ref, hop);
+	for (size_t d = 0; d <= range; d += 4)
+	{
+		s32 corr = Stretch_Dot(stretch_mono_seek + d, stretch_mono_ref, hop);
+		if (corr > best_corr)
+		{
+			best_corr = corr;
+			best = d;
+		}
+	}
+	size_t coarse = best;
+	for (size_t d = (coarse > 3) ? (coarse - 3) : 0; d <= coarse + 3 && d <= range; d++)
+	{
+		s32 corr = Stretch_Dot(stretch_mono_seek + d, stretch_mono_ref, hop);
+		if (corr > best_corr)
+		{
+			best_corr = corr;
+			best = d;
+		}
+	}
+	size_t start = lo + best;
+	
+	//Overlap-add the last segment's tail with the new segment's head
+	for (int i = 0; i < 2; i++)
+	{
+		const MP3Decode *mp3 = &xa_mp3[i];
+		s16 *out = stretch_out[i];
+		for (size_t j = 0; j < hop; j++)
+		{
+			s32 fade_in = stretch_fade[j];
+			s32 fade_out = 0x8000 - fade_in;
+			const s16 *tail = (stretch_ref + j < mp3->frames) ? (mp3->data + (stretch_ref + j) * channels) : NULL;
+			const s16 *head = (start + j < mp3->frames) ? (mp3->data + (start + j) * channels) : NULL;
+			for (u32 c = 0; c < channels; c++)
+			{
+				s32 v = (tail != NULL) ? (tail[c] * fade_out) : 0;
+				if (head != NULL)
+					v += head[c] * fade_in;
+				*out++ = (s16)((v + 0x4000) >> 15);
+			}
+		}
+	}
+	
+	//Advance
+	stretch_ref = start + hop;
+	stretch_pos += ((u64)hop * xa_rate) << (32 - XA_RATE_SHIFT);
+	stretch_read = 0;
+	stretch_avail = hop;
+	xa_pos = (size_t)(stretch_pos >> 32);
 }
 
-//XA files and tracks
-static CdlFILE xa_files[XA_TrackMax];
+static void Stretch_Frames(s16 *out, size_t frames)
+{
+	u32 channels = xa_device.playback.channels;
+	while (frames != 0)
+	{
+		if (stretch_read == stretch_avail)
+		{
+			//Check if songs ended
+			size_t nominal = (size_t)(stretch_pos >> 32);
+			if (nominal >= xa_mp3[0].frames && nominal >= xa_mp3[1].frames)
+			{
+				if (xa_state & XA_STATE_LOOPS)
+				{
+					//Reset position
+					Stretch_Reset();
+					xa_pos = xa_time_pos = 0;
+				}
+				else
+				{
+					//Stop playing
+					xa_state &= ~XA_STATE_PLAYING;
+					memset(out, 0, frames * bytes_per_frame);
+					return;
+				}
+			}
+			
+			//Produce next segment
+			Stretch_Step();
+		}
+		
+		//Mix produced frames into stream
+		size_t todo = stretch_avail - stretch_read;
+		if (todo > frames)
+			todo = frames;
+		Mix_Frames(out, stretch_out[0] + stretch_read * channels, stretch_out[1] + stretch_read * channels, todo);
+		
+		out += todo * channels;
+		frames -= todo;
+		stretch_read += todo;
+		xa_time_pos += todo;
+	}
+}
 
-#include "../audio_def.h"
+//Metronome
+static void Audio_MixClick(s16 *out, size_t frames, double callback_start)
+{
+	u32 channels = xa_device.playback.channels;
+	for (size_t i = 0; i < frames; i++, out += channels)
+	{
+		if (xa_click_phase == 0)
+		{
+			//Start next click and remember when it was mixed, in the same terms as Audio_TellXA_Milli
+			xa_click_phase = xa_click_interval;
+			xa_click_i = 0;
+			if (xa_clicks_num < AUDIO_CLICKS)
+				xa_clicks[xa_clicks_num++] = callback_start + (double)i / xa_device.sampleRate;
+		}
+		xa_click_phase--;
+		
+		//Mix click on top of whatever is playing
+		if (xa_click_i < xa_click_len)
+		{
+			s32 click = xa_click_wave[xa_click_i++];
+			for (u32 c = 0; c < channels; c++)
+			{
+				s32 v = out[c] + click;
+				if (v > 0x7FFF)
+					v = 0x7FFF;
+				if (v < -0x8000)
+					v = -0x8000;
+				out[c] = (s16)v;
+			}
+		}
+	}
+}
 
 //Miniaudio callback
+static const s16 xa_silence[0x400];
+
 static void Audio_Callback(ma_device *device, void *output_buffer_void, const void *input_buffer, ma_uint32 frames_to_do)
 {
+	(void)device;
 	(void)input_buffer;
 	
-	size_t bytes_to_do = frames_to_do * bytes_per_frame;
-	
 	//Lock mutex during mixing
 	ma_mutex_lock(&xa_mutex);
+	double callback_start = glfwGetTime();
 	
-	//Copy XA
+	//Mix XA
+	s16 *output_buffer = output_buffer_void;
 	if (xa_state & XA_STATE_PLAYING)
 	{
 		//Update timing state
 		xa_interptime = xa_lasttime;
 		xa_interpstart = glfwGetTime();
-		xa_lasttime = (double)(xa_mp3[xa_channel].datap - xa_mp3[xa_channel].data) / bytes_per_frame / xa_device.sampleRate;
+		xa_lasttime = (double)xa_time_pos / xa_device.sampleRate;
 		
-		//Copy MP3s into stream
-		unsigned char *output_buffer = output_buffer_void;
-		size_t bytes_remaining = bytes_to_do;
-		while (bytes_remaining != 0)
+		//Mix both MP3s into stream
+		u32 channels = xa_device.playback.channels;
+		size_t frames_remaining = (xa_rate != XA_RATE_UNIT) ? 0 : frames_to_do;
+		if (frames_remaining == 0)
+			Stretch_Frames(output_buffer, frames_to_do);
+		while (frames_remaining != 0)
 		{
-			size_t bytes_done = MP3Decode_Copy(&xa_mp3[xa_channel], output_buffer, bytes_remaining);
-			MP3Decode_Skip(&xa_mp3[xa_channel ^ 1], bytes_done);
-			
-			output_buffer += bytes_done;
-			bytes_remaining -= bytes_done;
-			
 			//Check if songs ended
-			if ((xa_mp3[0].data == NULL || xa_mp3[0].datap >= xa_mp3[0].datae) && (xa_mp3[1].data == NULL || xa_mp3[1].datap >= xa_mp3[1].datae))
+			if (xa_pos >= xa_mp3[0].frames && xa_pos >= xa_mp3[1].frames)
 			{
 				if (xa_state & XA_STATE_LOOPS)
 				{
-					//Reset pointers
-					xa_mp3[0].datap = xa_mp3[0].data;
-					xa_mp3[1].datap = xa_mp3[1].data;
+					//Reset position
+					xa_pos = xa_time_pos = 0;
 				}
 				else
 				{
 					//Stop playing
 					xa_state &= ~XA_STATE_PLAYING;
-					memset(output_buffer, 0, bytes_remaining);
+					memset(output_buffer, 0, frames_remaining * bytes_per_frame);
 					break;
 				}
 			}
+			
+			//Mix until either stream runs out, reading silence from a stream that already has
+			const s16 *src[2];
+			size_t frames_done = frames_remaining;
+			for (int i = 0; i < 2; i++)
+			{
+				size_t frames_left;
+				if (xa_pos < xa_mp3[i].frames)
+				{
+					src[i] = xa_mp3[i].data + xa_pos * channels;
+					frames_left = xa_mp3[i].frames - xa_pos;
+				}
+				else
+				{
+					src[i] = xa_silence;
+					frames_left = COUNT_OF(xa_silence) / channels;
+				}
+				if (frames_done > frames_left)
+					frames_done = frames_left;
+			}
+			
+			Mix_Frames(output_buffer, src[0], src[1], frames_done);
+			
+			output_buffer += frames_done * channels;
+			frames_remaining -= frames_done;
+			xa_pos += frames_done;
+			xa_time_pos += frames_done;
 		}
 	}
 	else
 	{
 		//Clear stream
-		memset(output_buffer_void, 0, bytes_to_do);
+		memset(output_buffer, 0, frames_to_do * bytes_per_frame);
+	}
+	
+	//Mix metronome
+	if (xa_click_interval != 0)
+		Audio_MixClick(output_buffer_void, frames_to_do, callback_start);
+	
+	//Update statistics
+	double callback_end = glfwGetTime();
+	u32 callback_us = (u32)((callback_end - callback_start) * 1000000.0);
+	
+	if (xa_stats.callbacks != 0)
+	{
+		//Count callbacks that came back later than the whole device buffer lasts
+		//This is only a guess from our side, miniaudio doesn't tell us about real xruns
+		double gap = callback_start - xa_stats_last;
+		if (gap * 1000000.0 > xa_stats.latency_us + xa_stats.latency_us / 2)
+			xa_stats.late_callbacks++;
 	}
+	xa_stats_last = callback_start;
+	
+	xa_stats.callbacks++;
+	xa_stats.callback_us = callback_us;
+	xa_stats.callback_us_avg = xa_stats.callback_us_avg - (xa_stats.callback_us_avg >> 4) + (callback_us >> 4);
+	if (callback_us > xa_stats.callback_us_max)
+		xa_stats.callback_us_max = callback_us;
 	
 	//Unlock mutex
 	ma_mutex_unlock(&xa_mutex);
 }
 
+//Track decoding
+static boolean Audio_DecodeTrack(MP3Decode *mp3, XA_Track track, char *fail)
+{
+	//Files are resolved at Audio_Init and never change, so the prefetch thread can read them freely
+	mp3[0].data = mp3[1].data = NULL;
+	mp3[0].frames = mp3[1].frames = 0;
+	mp3[0].map = mp3[1].map = NULL;
+	
+	if (MP3Decode_Decode(&mp3[0], &xa_files[track][0], fail) ||
+	    (xa_mp3s[track].vocal && MP3Decode_Decode(&mp3[1], &xa_files[track][1], fail)))
+	{
+		MP3Decode_Free(&mp3[0]);
+		MP3Decode_Free(&mp3[1]);
+		return true;
+	}
+	return false;
+}
+
+static ma_thread_result MA_THREADCALL Audio_PrefetchThread(void *user)
+{
+	(void)user;
+	
+	while (1)
+	{
+		//Wait for a track to be requested
+		ma_semaphore_wait(&xa_prefetch_sem);
+		if (xa_prefetch_quit)
+			break;
+		
+		//Decode track and publish it, along with why it failed if it did
+		xa_prefetch_fail[0] = '\0';
+		Audio_DecodeTrack(xa_prefetch_mp3, xa_prefetch_track, xa_prefetch_fail);
+		c89atomic_store_32(&xa_prefetch_state, XA_PREFETCH_READY);
+		ma_event_signal(&xa_prefetch_done);
+	}
+	return (ma_thread_result)0;
+}
+
+static void Audio_PrefetchWait(void)
+{
+	//Wait for the prefetch thread to finish its current track
+	while (c89atomic_load_32(&xa_prefetch_state) == XA_PREFETCH_PENDING)
+		ma_event_wait(&xa_prefetch_done);
+}
+
+static void Audio_PrefetchDiscard(void)
+{
+	//Throw away a prefetched track we're not going to use
+	Audio_PrefetchWait();
+	if (c89atomic_load_32(&xa_prefetch_state) == XA_PREFETCH_READY)
+	{
+		MP3Decode_Free(&xa_prefetch_mp3[0]);
+		MP3Decode_Free(&xa_prefetch_mp3[1]);
+		c89atomic_store_32(&xa_prefetch_state, XA_PREFETCH_IDLE);
+	}
+}
+
 //Audio functions
 void Audio_Init(void)
 {
 	//Get file positions
-	CdlFILE *filep = xa_files;
+	CdlFILE (*filep)[2] = xa_files;
 	for (const XA_Mp3 *mp3 = xa_mp3s; mp3->name != NULL; mp3++, filep++)
 	{
 		char apath[64];
 		if (mp3->vocal)
 		{
 			sprintf(apath, "\\MUSIC\\%sv.mp3;1", mp3->name);
-			IO_FindFile(filep, apath);
+			IO_FindFile(&(*filep)[0], apath);
+			sprintf(apath, "\\MUSIC\\%si.mp3;1", mp3->name);
+			IO_FindFile(&(*filep)[1], apath);
 		}
 		else
 		{
 			sprintf(apath, "\\MUSIC\\%s.mp3;1", mp3->name);
-			IO_FindFile(filep, apath);
+			IO_FindFile(&(*filep)[0], apath);
 		}
 	}
 	
 	//Initialize XA state
 	xa_track = -1;
-	xa_channel = 0;
 	
 	xa_state = 0;
+	xa_pos = xa_time_pos = 0;
+	xa_rate = XA_RATE_UNIT;
+	Stretch_Reset();
+	
+	xa_gain[0] = xa_gain_target[0] = XA_GAIN_UNIT;
+	xa_gain[1] = xa_gain_target[1] = 0;
 	
 	xa_mp3[0].data = NULL;
+	xa_mp3[0].map = NULL;
 	xa_mp3[1].data = NULL;
+	xa_mp3[1].map = NULL;
 	
 	//Initialize miniaudio
 	if (ma_context_init(NULL, 0, NULL, &xa_context) != MA_SUCCESS)
@@ -280,23 +1410,94 @@ void Audio_Init(void)
 	//Create miniaudio device
 	ma_device_config config = ma_device_config_init(ma_device_type_playback);
 	config.playback.pDeviceID = NULL;
-	config.playback.format = ma_format_unknown; //Use native format
+	config.playback.format = ma_format_s16;     //We mix in s16, miniaudio converts to the native format
 	config.playback.channels = 0;               //Use native channel count
 	config.sampleRate = 0;                      //Use native sample rate
 	config.noPreZeroedOutputBuffer = MA_TRUE; //We will clear this buffer ourselves if needed
 	config.dataCallback = Audio_Callback;
 	config.pUserData = NULL;
 	
-	if (ma_device_init(&xa_context, &config, &xa_device) != MA_SUCCESS)
+	#ifdef AUDIO_LOWLATENCY
+		config.performanceProfile = ma_performance_profile_low_latency;
+		config.periodSizeInFrames = AUDIO_PERIOD_FRAMES;
+		config.periods = AUDIO_PERIODS;
+	#endif
+	
+	ma_result result = MA_ERROR;
+	#ifdef AUDIO_EXCLUSIVE
+		//Try exclusive mode first, skipping ALSA's conversion plugins
+		config.playback.shareMode = ma_share_mode_exclusive;
+		config.alsa.noAutoFormat = MA_TRUE;
+		config.alsa.noAutoChannels = MA_TRUE;
+		config.alsa.noAutoResample = MA_TRUE;
+		result = ma_device_init(&xa_context, &config, &xa_device);
+		
+		config.playback.shareMode = ma_share_mode_shared;
+		config.alsa.noAutoFormat = MA_FALSE;
+		config.alsa.noAutoChannels = MA_FALSE;
+		config.alsa.noAutoResample = MA_FALSE;
+	#endif
+	if (result != MA_SUCCESS)
+		result = ma_device_init(&xa_context, &config, &xa_device);
+	
+	if (result != MA_SUCCESS)
 	{
 		sprintf(error_msg, "[Audio_Init] Failed to create miniaudio device");
 		ErrorLock();
 		return;
 	}
 	
+	//Remember what the backend actually gave us
+	memset(&xa_stats, 0, sizeof(xa_stats));
+	xa_stats.period_frames = xa_device.playback.internalPeriodSizeInFrames;
+	xa_stats.periods = xa_device.playback.internalPeriods;
+	xa_stats.sample_rate = xa_device.playback.internalSampleRate;
+	if (xa_stats.sample_rate != 0)
+		xa_stats.latency_us = (u32)((u64)xa_stats.period_frames * xa_stats.periods * 1000000 / xa_stats.sample_rate);
+	
 	//Cache this for later, so we don't have to calculate it constantly
 	bytes_per_frame = ma_get_bytes_per_frame(xa_device.playback.format, xa_device.playback.channels);
 	
+	xa_gain_step = XA_GAIN_UNIT * 1000 / XA_RAMP_MS / xa_device.sampleRate;
+	if (xa_gain_step < 1)
+		xa_gain_step = 1;
+	
+	//Prepare time-stretch, rate changes are only allowed if the device fits our buffers
+	stretch_hop = (xa_device.sampleRate * STRETCH_HOP_MS / 1000) & ~7;
+	if (stretch_hop > STRETCH_MAX_HOP)
+		stretch_hop = STRETCH_MAX_HOP;
+	stretch_seek = xa_device.sampleRate * STRETCH_SEEK_MS / 1000;
+	if (stretch_seek > STRETCH_MAX_SEEK)
+		stretch_seek = STRETCH_MAX_SEEK;
+	if (xa_device.playback.channels > STRETCH_MAX_CHANNELS)
+		stretch_hop = 0;
+	
+	for (size_t i = 0; i < stretch_hop; i++)
+	{
+		double s = sin(MA_PI_D * 0.5 * (i + 0.5) / stretch_hop);
+		stretch_fade[i] = (s16)(s * s * 0x7FFF);
+	}
+	
+	#ifdef AUDIO_CACHE
+		//Prepare PCM cache
+		AudioCache_Init();
+	#endif
+	
+	//Read calibrated latency
+	xa_click_interval = 0;
+	xa_clicks_num = 0;
+	xa_latency = 0;
+	
+	char latency_path[0x200];
+	Audio_GetDataPath(latency_path, sizeof(latency_path), AUDIO_LATENCY_FILE);
+	FILE *latency_fp = fopen(latency_path, "r");
+	if (latency_fp != NULL)
+	{
+		if (fscanf(latency_fp, "%d", &xa_latency) != 1)
+			xa_latency = 0;
+		fclose(latency_fp);
+	}
+	
 	if (ma_mutex_init(&xa_mutex) != MA_SUCCESS)
 	{
 		sprintf(error_msg, "[Audio_Init] Failed to create miniaudio mutex");
@@ -304,6 +1505,19 @@ void Audio_Init(void)
 		return;
 	}
 	
+	//Start prefetch thread
+	xa_prefetch_track = -1;
+	xa_prefetch_quit = false;
+	c89atomic_store_32(&xa_prefetch_state, XA_PREFETCH_IDLE);
+	if (ma_semaphore_init(0, &xa_prefetch_sem) != MA_SUCCESS ||
+	    ma_event_init(&xa_prefetch_done) != MA_SUCCESS ||
+	    ma_thread_create(&xa_prefetch_thread, ma_thread_priority_normal, 0, Audio_PrefetchThread, NULL, NULL) != MA_SUCCESS)
+	{
+		sprintf(error_msg, "[Audio_Init] Failed to create prefetch thread");
+		ErrorLock();
+		return;
+	}
+	
 	ma_device_start(&xa_device);
 }
 
@@ -315,9 +1529,18 @@ void Audio_Quit(void)
 	ma_device_uninit(&xa_device);
 	ma_context_uninit(&xa_context);
 	
+	//Stop prefetch thread
+	Audio_PrefetchDiscard();
+	xa_prefetch_quit = true;
+	ma_semaphore_release(&xa_prefetch_sem);
+	ma_thread_wait(&xa_prefetch_thread);
+	ma_event_uninit(&xa_prefetch_done);
+	ma_semaphore_uninit(&xa_prefetch_sem);
+	
 	//Free mp3s
-	free(xa_mp3[0].data);
-	free(xa_mp3[1].data);
+	MP3Decode_Count(xa_mp3, -1);
+	MP3Decode_Free(&xa_mp3[0]);
+	MP3Decode_Free(&xa_mp3[1]);
 }
 
 void Audio_PlayXA_Track(XA_Track track, u8 volume, u8 channel, boolean loop)
@@ -338,38 +1561,74 @@ void Audio_SeekXA_Track(XA_Track track)
 	
 	//Reset XA state
 	xa_state = 0;
-	xa_channel = 0;
+	xa_pos = xa_time_pos = 0;
+	xa_rate = XA_RATE_UNIT;
+	Stretch_Reset();
+	xa_gain[0] = xa_gain_target[0] = XA_GAIN_UNIT;
+	xa_gain[1] = xa_gain_target[1] = 0;
 	xa_lasttime = xa_interptime = 0.0;
 	xa_interpstart = glfwGetTime();
 	
+	//Unlock mutex
+	ma_mutex_unlock(&xa_mutex);
+	
 	//Read file if different track
 	if (track != xa_track)
 	{
-		//Free previous track
-		free(xa_mp3[0].data);
-		free(xa_mp3[1].data);
-		
-		//Read new track
-		if (xa_mp3s[track].vocal)
+		//Take the prefetched track if it's the one we want, otherwise decode it now
+		MP3Decode next[2];
+		char fail[AUDIO_FAIL_MAX];
+		Audio_PrefetchWait();
+		if (c89atomic_load_32(&xa_prefetch_state) == XA_PREFETCH_READY && xa_prefetch_track == track)
 		{
-			char *path = xa_files[track].path;
-			path[strlen(path) - 5] = 'v';
-			MP3Decode_Decode(&xa_mp3[0], &xa_files[track]);
-			path[strlen(path) - 5] = 'i';
-			MP3Decode_Decode(&xa_mp3[1], &xa_files[track]);
+			next[0] = xa_prefetch_mp3[0];
+			next[1] = xa_prefetch_mp3[1];
+			xa_prefetch_track = -1;
+			strcpy(fail, xa_prefetch_fail);
+			c89atomic_store_32(&xa_prefetch_state, XA_PREFETCH_IDLE);
 		}
 		else
 		{
-			MP3Decode_Decode(&xa_mp3[0], &xa_files[track]);
-			xa_mp3[1].data = NULL;
+			Audio_PrefetchDiscard();
+			if (!Audio_DecodeTrack(next, track, fail))
+				fail[0] = '\0';
 		}
 		
-		//Remember
+		//Report decode failures here on the main thread
+		if (fail[0] != '\0')
+		{
+			sprintf(error_msg, "%s", fail);
+			ErrorLock();
+			return;
+		}
+		
+		//Swap in new track while the callback is locked out
+		ma_mutex_lock(&xa_mutex);
+		MP3Decode prev[2] = {xa_mp3[0], xa_mp3[1]};
+		xa_mp3[0] = next[0];
+		xa_mp3[1] = next[1];
 		xa_track = track;
+		ma_mutex_unlock(&xa_mutex);
+		MP3Decode_Count(next, 1);
+		
+		//Free previous track
+		MP3Decode_Count(prev, -1);
+		MP3Decode_Free(&prev[0]);
+		MP3Decode_Free(&prev[1]);
 	}
+}
+
+void Audio_PrefetchXA_Track(XA_Track track)
+{
+	//Ignore if already playing or prepared
+	if (track == xa_track || (track == xa_prefetch_track && c89atomic_load_32(&xa_prefetch_state) != XA_PREFETCH_IDLE))
+		return;
 	
-	//Unlock mutex
-	ma_mutex_unlock(&xa_mutex);
+	//Hand track to the prefetch thread
+	Audio_PrefetchDiscard();
+	xa_prefetch_track = track;
+	c89atomic_store_32(&xa_prefetch_state, XA_PREFETCH_PENDING);
+	ma_semaphore_release(&xa_prefetch_sem);
 }
 
 void Audio_PauseXA(void)
@@ -388,25 +1647,129 @@ void Audio_StopXA(void)
 	//Set XA state
 	xa_track = -1;
 	xa_state = 0;
-	xa_channel = 0;
+	xa_pos = xa_time_pos = 0;
+	xa_rate = XA_RATE_UNIT;
+	Stretch_Reset();
+	xa_gain[0] = xa_gain_target[0] = XA_GAIN_UNIT;
+	xa_gain[1] = xa_gain_target[1] = 0;
 	xa_lasttime = xa_interptime = 0.0;
 	xa_interpstart = glfwGetTime();
 	
 	//Free previous track
-	free(xa_mp3[0].data); xa_mp3[0].data = NULL;
-	free(xa_mp3[1].data); xa_mp3[1].data = NULL;
+	MP3Decode_Count(xa_mp3, -1);
+	MP3Decode_Free(&xa_mp3[0]);
+	MP3Decode_Free(&xa_mp3[1]);
 	
 	//Unlock mutex
 	ma_mutex_unlock(&xa_mutex);
 }
 
+void Audio_SetRateXA(fixed_t rate)
+{
+	//Clamp to what the stretcher can do
+	if (rate < FIXED_DEC(1,2))
+		rate = FIXED_DEC(1,2);
+	if (rate > FIXED_DEC(2,1))
+		rate = FIXED_DEC(2,1);
+	u32 next_rate = (u32)rate << (XA_RATE_SHIFT - FIXED_SHIFT);
+	if (stretch_hop == 0)
+		next_rate = XA_RATE_UNIT;
+	
+	//Lock mutex during state modification
+	ma_mutex_lock(&xa_mutex);
+	if (next_rate != xa_rate)
+	{
+		//Carry on from the current position
+		xa_rate = next_rate;
+		stretch_pos = (u64)xa_pos << 32;
+		stretch_ref = xa_pos;
+		stretch_read = stretch_avail = 0;
+	}
+	ma_mutex_unlock(&xa_mutex);
+}
+
 void Audio_ChannelXA(u8 channel)
 {
 	//Lock mutex during state modification
 	ma_mutex_lock(&xa_mutex);
 	if (xa_mp3s[xa_track].vocal)
-		xa_channel = channel & 1;
+	{
+		//Fade to the requested stream, the callback ramps towards these
+		xa_gain_target[channel & 1] = XA_GAIN_UNIT;
+		xa_gain_target[(channel & 1) ^ 1] = 0;
+	}
+	ma_mutex_unlock(&xa_mutex);
+}
+
+void Audio_GetStats(Audio_Stats *stats)
+{
+	//Lock mutex so we don't read a half updated copy
+	ma_mutex_lock(&xa_mutex);
+	*stats = xa_stats;
+	ma_mutex_unlock(&xa_mutex);
+}
+
+s32 Audio_GetLatency(void)
+{
+	return xa_latency;
+}
+
+void Audio_SetLatency(s32 latency)
+{
+	//Remember latency for next time
+	xa_latency = latency;
+	
+	char latency_path[0x200];
+	Audio_GetDataPath(latency_path, sizeof(latency_path), AUDIO_LATENCY_FILE);
+	FILE *latency_fp = fopen(latency_path, "w");
+	if (latency_fp != NULL)
+	{
+		fprintf(latency_fp, "%d\n", (int)latency);
+		fclose(latency_fp);
+	}
+}
+
+void Audio_PlayClick(u32 interval)
+{
+	//Lock mutex during state modification
+	ma_mutex_lock(&xa_mutex);
+	
+	if (interval != 0 && xa_click_interval == 0)
+	{
+		//Generate click, a decaying sine
+		xa_click_len = xa_device.sampleRate * AUDIO_CLICK_MS / 1000;
+		if (xa_click_len > COUNT_OF(xa_click_wave))
+			xa_click_len = COUNT_OF(xa_click_wave);
+		for (size_t i = 0; i < xa_click_len; i++)
+		{
+			double t = (double)i / xa_device.sampleRate;
+			xa_click_wave[i] = (s16)(sin(2.0 * MA_PI_D * 1500.0 * t) * exp(-t * 150.0) * 0x3000);
+		}
+		
+		//Start the first click on the next callback
+		xa_click_phase = 0;
+		xa_click_i = xa_click_len;
+		xa_clicks_num = 0;
+	}
+	xa_click_interval = (u32)((u64)interval * xa_device.sampleRate / 1000);
+	
+	ma_mutex_unlock(&xa_mutex);
+}
+
+u8 Audio_GetClicks(double *times, u8 max)
+{
+	//Lock mutex during state check
+	ma_mutex_lock(&xa_mutex);
+	
+	//Take logged click times
+	if (max > xa_clicks_num)
+		max = xa_clicks_num;
+	memcpy(times, xa_clicks, max * sizeof(double));
+	memmove(xa_clicks, xa_clicks + max, (xa_clicks_num - max) * sizeof(double));
+	xa_clicks_num -= max;
+	
 	ma_mutex_unlock(&xa_mutex);
+	return max;
 }
 
 s32 Audio_TellXA_Sector(void)
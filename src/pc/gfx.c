@@ -36,6 +36,7 @@
 
 //Window
 GLFWwindow *window;
+double window_poll_time; //When glfwPollEvents last returned
 
 //Render state
 static mat4 projection;
@@ -672,6 +673,7 @@ void Gfx_Flip(void)
 	
 	//Handle events
 	glfwPollEvents();
+	window_poll_time = glfwGetTime();
 	
 	//Initialize frame
 	dlist_p = dlist;
@@ -701,6 +703,8 @@ void Gfx_DisableClear(void)
 
 void Gfx_LoadTex(Gfx_Tex *tex, IO_Data data, Gfx_LoadTex_Flag flag)
 {
+	double stats_start = IO_StatsTime();
+	
 	//Read TIM header
 	u8 tim_header = ((u8*)data)[4];
 	u8 tim_bpp = tim_header & 3;
@@ -939,6 +943,8 @@ void Gfx_LoadTex(Gfx_Tex *tex, IO_Data data, Gfx_LoadTex_Flag flag)
 	
 	if (flag & GFX_LOADTEX_FREE)
 		Mem_Free(data);
+	
+	IO_StatsTex(stats_start);
 }
 
 void Gfx_DrawRect(const RECT *rect, u8 r, u8 g, u8 b)
@@ -9,9 +9,865 @@
 #include "../main.h"
 #include "../mem.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <sys/stat.h>
+#include <dirent.h>
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#ifdef PSXF_WIN32
+ #define RECT RECT_unconflict
+ #define POINT POINT_unconflict
+ #define boolean boolean_unconflict
+ #include <windows.h>
+ #undef boolean
+ #undef POINT
+ #undef RECT
+ #include <io.h>
+#else
+ #include <sys/mman.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <pthread.h>
+#endif
+
+//IO constants
+#ifndef PSXF_STDMEM
+ #define IO_MMAP //Map large files instead of reading them into the heap, Mem_Free unmaps them
+#endif
+#define IO_MMAP_MIN  0x10000 //Smaller files are cheaper to just read
+#define IO_MMAP_MAX  64      //Files that can be mapped at once
+
+#define IO_ASYNC //Read files on worker threads in IO_AsyncReadFile
+#define IO_ASYNC_MAX     32 //Reads that can be queued at once
+#define IO_ASYNC_THREADS 4  //Reads in flight at once, loads are latency bound so a few help
+
+#define IO_PREFETCH_MAX    32      //Files that can be prefetched at once
+#define IO_PREFETCH_BUDGET 0x40000 //Heap that prefetched files may hold, mapped files are free
+
+//#define IO_STATS_PRINT //Print load telemetry to stdout when a load ends
+
+#define IO_PAK //Mount ISO.PAK next to the ISO directory if it exists, loose files are used for anything it doesn't have
+#define IO_PAK_NAME "ISO.PAK"
+#define IO_PAK_VERSION 1
+
+#define IO_PAK_METHOD_STORE 0
+#define IO_PAK_METHOD_LZ4   1
+
+#define IO_INDEX //Index the ISO directory and bundle at IO_Init so IO_FindFile resolves files with one hash probe
+#define IO_INDEX_DEPTH 8     //Deepest directory that gets indexed
+#define IO_INDEX_PATH  0x400 //Longest host path that gets indexed
+
+#define IO_ARC_METHOD_STORE 0
+#define IO_ARC_METHOD_LZ4   1
+
 //ISO directory
 char *iso_dir = NULL;
 
+//Native file handles
+#ifdef PSXF_WIN32
+	typedef HANDLE IO_Native;
+	#define IO_NativeOf(fp) ((HANDLE)_get_osfhandle(_fileno(fp)))
+#else
+	typedef int IO_Native;
+	#define IO_NativeOf(fp) fileno(fp)
+#endif
+
+//File source, either a loose file or an entry in the bundle
+typedef struct
+{
+	FILE *fp; //NULL if in the bundle
+	size_t pos, size;
+	size_t expand; //Size of the file once expanded, 0 if it's not compressed
+	boolean block; //Compressed as a single LZ4 block in the bundle rather than a FARZ archive
+} IO_Source;
+
+//Path hashing
+static u32 IO_PathHashChar(u32 hash, char c)
+{
+	//FNV-1a of the upper case path, must match funkinpak
+	return (hash ^ (u8)toupper((unsigned char)c)) * 0x01000193;
+}
+
+static u32 IO_PathHash(const char *path)
+{
+	u32 hash = 0x811C9DC5;
+	for (; *path != '\0'; path++)
+		hash = IO_PathHashChar(hash, *path);
+	return hash;
+}
+
+static boolean IO_PathCompare(const char *a, const char *b)
+{
+	//Case insensitive like the ISO9660 filesystem
+	for (; *a != '\0'; a++, b++)
+		if (toupper((unsigned char)*a) != toupper((unsigned char)*b))
+			return true;
+	return *b != '\0';
+}
+
+#ifdef IO_PAK
+
+//Bundle directory
+typedef struct
+{
+	u32 hash;
+	u32 name; //Offset of name in the bundle, 0 if the slot is empty
+	u32 pos; //In sectors
+	u32 size;
+	u32 packed;
+	u32 method;
+} IO_PakEntry;
+
+static IO_Native io_pak;
+static boolean io_pak_mounted;
+static IO_PakEntry *io_pak_entry;
+static u32 io_pak_slots;
+static char *io_pak_names;
+static u32 io_pak_names_pos, io_pak_names_size;
+
+static boolean IO_PakRead(void *data, size_t pos, size_t size)
+{
+	//Positioned reads don't share a file pointer, so the worker and main thread can read at once
+	u8 *datap = (u8*)data;
+	while (size != 0)
+	{
+		#ifdef PSXF_WIN32
+			OVERLAPPED overlapped = {0};
+			overlapped.Offset = (DWORD)pos;
+			overlapped.OffsetHigh = (DWORD)((unsigned long long)pos >> 32);
+			DWORD got;
+			if (!ReadFile(io_pak, datap, (size > 0x40000000) ? 0x40000000 : (DWORD)size, &got, &overlapped) || got == 0)
+				return true;
+		#else
+			ssize_t got = pread(io_pak, datap, size, (off_t)pos);
+			if (got <= 0)
+				return true;
+		#endif
+		datap += got;
+		pos += got;
+		size -= got;
+	}
+	return false;
+}
+
+static void IO_PakClose(void)
+{
+	#ifdef PSXF_WIN32
+		CloseHandle(io_pak);
+	#else
+		close(io_pak);
+	#endif
+	free(io_pak_entry);
+	io_pak_entry = NULL;
+	io_pak_names = NULL;
+	io_pak_mounted = false;
+}
+
+static void IO_PakMount(void)
+{
+	//Get path next to the ISO directory
+	char path[0x200];
+	path[0] = '\0';
+	if (iso_dir != NULL)
+	{
+		size_t len = strlen(iso_dir);
+		if (len - 4 + sizeof(IO_PAK_NAME) > sizeof(path))
+			return;
+		memcpy(path, iso_dir, len - 4); //Cut "ISO/"
+		path[len - 4] = '\0';
+	}
+	strcat(path, IO_PAK_NAME);
+	
+	//Open bundle, it's fine if there isn't one
+	#ifdef PSXF_WIN32
+		if ((io_pak = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL)) == INVALID_HANDLE_VALUE)
+			return;
+	#else
+		if ((io_pak = open(path, O_RDONLY)) < 0)
+			return;
+	#endif
+	io_pak_mounted = true;
+	
+	//Read header
+	u32 header[4];
+	if (IO_PakRead(header, 0, sizeof(header)) ||
+	    memcmp(header, "FPAK", 4) != 0 ||
+	    header[1] != IO_PAK_VERSION ||
+	    header[2] == 0 || (header[2] & (header[2] - 1)) != 0)
+	{
+		IO_PakClose();
+		snprintf(error_msg, sizeof(error_msg), "[IO_PakMount] %.*s is not a valid bundle", 0x100, path);
+		ErrorLock();
+		return;
+	}
+	io_pak_slots = header[2];
+	io_pak_names_pos = sizeof(header) + io_pak_slots * sizeof(IO_PakEntry);
+	io_pak_names_size = header[3];
+	
+	//Read hash table and names in one go
+	size_t dir_size = io_pak_names_pos - sizeof(header) + io_pak_names_size;
+	if ((io_pak_entry = malloc(dir_size + 1)) == NULL)
+	{
+		IO_PakClose();
+		sprintf(error_msg, "[IO_PakMount] Failed to allocate directory (size 0x%X)", (unsigned int)dir_size);
+		ErrorLock();
+		return;
+	}
+	if (IO_PakRead(io_pak_entry, sizeof(header), dir_size))
+	{
+		IO_PakClose();
+		snprintf(error_msg, sizeof(error_msg), "[IO_PakMount] Failed to read directory of %.*s", 0x100, path);
+		ErrorLock();
+		return;
+	}
+	io_pak_names = (char*)(io_pak_entry + io_pak_slots);
+	io_pak_names[io_pak_names_size] = '\0';
+}
+
+static const IO_PakEntry *IO_PakFind(const char *path)
+{
+	if (!io_pak_mounted)
+		return NULL;
+	
+	//Probe from the hashed slot until an empty one
+	u32 hash = IO_PathHash(path);
+	for (u32 slot = hash & (io_pak_slots - 1);; slot = (slot + 1) & (io_pak_slots - 1))
+	{
+		const IO_PakEntry *entry = &io_pak_entry[slot];
+		if (entry->name == 0)
+			return NULL;
+		if (entry->hash == hash &&
+		    entry->name - io_pak_names_pos < io_pak_names_size &&
+		    !IO_PathCompare(io_pak_names + (entry->name - io_pak_names_pos), path))
+			return entry;
+	}
+}
+
+#endif
+
+#ifdef IO_INDEX
+
+//Directory index
+typedef struct
+{
+	u32 hash;
+	u32 name; //Offset of the host path in io_index_names
+	u32 rel; //Length of the ISO directory at the start of the host path
+	u32 size;
+	u32 pak; //Bundle slot + 1, 0 if it's a loose file
+} IO_IndexEntry;
+
+static IO_IndexEntry *io_index;
+static u32 io_index_num, io_index_cap;
+static u32 *io_index_slot; //Entry + 1, 0 if the slot is empty
+static u32 io_index_slots;
+static char *io_index_names;
+static size_t io_index_names_size, io_index_names_cap;
+
+static void IO_IndexFree(void)
+{
+	free(io_index);
+	free(io_index_slot);
+	free(io_index_names);
+	io_index = NULL;
+	io_index_slot = NULL;
+	io_index_names = NULL;
+	io_index_num = io_index_cap = 0;
+	io_index_slots = 0;
+	io_index_names_size = io_index_names_cap = 0;
+}
+
+static u32 IO_IndexProbe(u32 hash, const char *path)
+{
+	if (io_index_slots == 0)
+		return 0;
+	
+	//Probe from the hashed slot until an empty one
+	for (u32 slot = hash & (io_index_slots - 1);; slot = (slot + 1) & (io_index_slots - 1))
+	{
+		u32 i = io_index_slot[slot];
+		if (i == 0)
+			return 0;
+		const IO_IndexEntry *entry = &io_index[i - 1];
+		if (entry->hash == hash && !IO_PathCompare(io_index_names + entry->name + entry->rel, path))
+			return i;
+	}
+}
+
+static boolean IO_IndexGrow(void)
+{
+	//Keep the table at most half full
+	u32 slots = io_index_slots ? (io_index_slots << 1) : 0x100;
+	u32 *slot = calloc(slots, sizeof(u32));
+	if (slot == NULL)
+		return true;
+	for (u32 i = 0; i < io_index_num; i++)
+	{
+		u32 j = io_index[i].hash & (slots - 1);
+		while (slot[j] != 0)
+			j = (j + 1) & (slots - 1);
+		slot[j] = i + 1;
+	}
+	free(io_index_slot);
+	io_index_slot = slot;
+	io_index_slots = slots;
+	return false;
+}
+
+static boolean IO_IndexAdd(const char *name, u32 rel, u32 size, u32 pak)
+{
+	//Files in the bundle are added first and take priority over loose ones
+	u32 hash = IO_PathHash(name + rel);
+	if (IO_IndexProbe(hash, name + rel) != 0)
+		return false;
+	
+	//Make room for entry and name
+	size_t name_size = strlen(name) + 1;
+	if (io_index_num == io_index_cap)
+	{
+		u32 cap = io_index_cap ? (io_index_cap << 1) : 0x100;
+		IO_IndexEntry *index = realloc(io_index, cap * sizeof(IO_IndexEntry));
+		if (index == NULL)
+			return true;
+		io_index = index;
+		io_index_cap = cap;
+	}
+	if (io_index_names_size + name_size > io_index_names_cap)
+	{
+		size_t cap = io_index_names_cap ? io_index_names_cap : 0x2000;
+		while (io_index_names_size + name_size > cap)
+			cap <<= 1;
+		char *names = realloc(io_index_names, cap);
+		if (names == NULL)
+			return true;
+		io_index_names = names;
+		io_index_names_cap = cap;
+	}
+	if ((io_index_num + 1) * 2 > io_index_slots && IO_IndexGrow())
+		return true;
+	
+	//Add entry
+	IO_IndexEntry *entry = &io_index[io_index_num++];
+	entry->hash = hash;
+	entry->name = io_index_names_size;
+	entry->rel = rel;
+	entry->size = size;
+	entry->pak = pak;
+	memcpy(io_index_names + io_index_names_size, name, name_size);
+	io_index_names_size += name_size;
+	
+	u32 slot = hash & (io_index_slots - 1);
+	while (io_index_slot[slot] != 0)
+		slot = (slot + 1) & (io_index_slots - 1);
+	io_index_slot[slot] = io_index_num;
+	return false;
+}
+
+static boolean IO_IndexWalk(char *path, size_t len, size_t rel, int depth)
+{
+	DIR *dir = opendir((len != 0) ? path : ".");
+	if (dir == NULL)
+		return false;
+	
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL)
+	{
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+			continue;
+		
+		//Get host path of entry
+		size_t name_len = strlen(ent->d_name);
+		if (len + name_len + 2 > IO_INDEX_PATH)
+			continue;
+		memcpy(path + len, ent->d_name, name_len + 1);
+		
+		struct stat st;
+		if (stat(path, &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+		{
+			//Index subdirectory
+			if (depth < IO_INDEX_DEPTH)
+			{
+				path[len + name_len] = '/';
+				path[len + name_len + 1] = '\0';
+				if (IO_IndexWalk(path, len + name_len + 1, rel, depth + 1))
+				{
+					closedir(dir);
+					return true;
+				}
+			}
+		}
+		else if (S_ISREG(st.st_mode))
+		{
+			//Index file
+			if (IO_IndexAdd(path, rel, st.st_size, 0))
+			{
+				closedir(dir);
+				return true;
+			}
+		}
+	}
+	
+	closedir(dir);
+	return false;
+}
+
+static void IO_IndexBuild(void)
+{
+	#ifdef IO_PAK
+		//Index bundled files
+		if (io_pak_mounted)
+		{
+			for (u32 i = 0; i < io_pak_slots; i++)
+			{
+				const IO_PakEntry *entry = &io_pak_entry[i];
+				if (entry->name == 0 || entry->name - io_pak_names_pos >= io_pak_names_size)
+					continue;
+				if (IO_IndexAdd(io_pak_names + (entry->name - io_pak_names_pos), 0, entry->size, i + 1))
+				{
+					IO_IndexFree();
+					return;
+				}
+			}
+		}
+	#endif
+	
+	//Index loose files
+	char path[IO_INDEX_PATH];
+	size_t len = 0;
+	if (iso_dir != NULL)
+	{
+		if ((len = strlen(iso_dir)) >= sizeof(path) / 2)
+			return;
+		memcpy(path, iso_dir, len + 1);
+	}
+	else
+	{
+		path[0] = '\0';
+	}
+	if (IO_IndexWalk(path, len, len, 0))
+		IO_IndexFree();
+}
+
+#endif
+
+#ifdef IO_MMAP
+
+//Mapped files
+static struct
+{
+	void *ptr, *base;
+	size_t size;
+} io_maps[IO_MMAP_MAX];
+
+static size_t io_map_align;
+
+static void IO_Unmap(void *ptr)
+{
+	//Find and release mapping
+	for (size_t i = 0; i < IO_MMAP_MAX; i++)
+	{
+		if (io_maps[i].ptr == ptr)
+		{
+			#ifdef PSXF_WIN32
+				UnmapViewOfFile(io_maps[i].base);
+			#else
+				munmap(io_maps[i].base, io_maps[i].size);
+			#endif
+			io_maps[i].ptr = NULL;
+			return;
+		}
+	}
+}
+
+static IO_Data IO_Map(IO_Native native, size_t pos, size_t size)
+{
+	//Find free slot
+	size_t slot = 0;
+	for (; slot < IO_MMAP_MAX; slot++)
+		if (io_maps[slot].ptr == NULL)
+			break;
+	if (slot == IO_MMAP_MAX)
+		return NULL;
+	
+	//Views have to start on the allocation granularity, bundle entries are only sector aligned
+	size_t skip = pos % io_map_align;
+	pos -= skip;
+	size += skip;
+	
+	//Map file copy-on-write, callers are allowed to scribble over their data
+	#ifdef PSXF_WIN32
+		HANDLE mapping = CreateFileMappingA(native, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (mapping == NULL)
+			return NULL;
+		void *base = MapViewOfFile(mapping, FILE_MAP_COPY, (DWORD)((unsigned long long)pos >> 32), (DWORD)pos, size);
+		CloseHandle(mapping); //The view keeps the mapping alive
+		if (base == NULL)
+			return NULL;
+	#else
+		void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, native, (off_t)pos);
+		if (base == MAP_FAILED)
+			return NULL;
+		madvise(base, size, MADV_WILLNEED);
+	#endif
+	
+	io_maps[slot].ptr = (u8*)base + skip;
+	io_maps[slot].base = base;
+	io_maps[slot].size = size;
+	return (IO_Data)io_maps[slot].ptr;
+}
+
+#endif
+
+static boolean IO_ReadRaw(IO_Source *source, void *data, size_t pos, size_t size)
+{
+	#ifdef IO_PAK
+		if (source->fp == NULL)
+			return IO_PakRead(data, source->pos + pos, size);
+	#endif
+	
+	//Read loose file
+	if (size == 0)
+		return false;
+	fseek(source->fp, source->pos + pos, SEEK_SET);
+	return fread(data, size, 1, source->fp) != 1;
+}
+
+static u32 IO_Get32(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static boolean IO_LZ4Decode(u8 *dst, size_t dst_size, const u8 *src, size_t src_size)
+{
+	//Decode LZ4 block, every length is checked as the data comes off disk
+	const u8 *ip = src, *ip_end = src + src_size;
+	u8 *op = dst, *op_end = dst + dst_size;
+	
+	while (ip < ip_end)
+	{
+		//Copy literals
+		u8 token = *ip++;
+		size_t len = token >> 4;
+		if (len == 15)
+		{
+			u8 add;
+			do
+			{
+				if (ip >= ip_end)
+					return true;
+				len += (add = *ip++);
+			} while (add == 255);
+		}
+		if (len > (size_t)(ip_end - ip) || len > (size_t)(op_end - op))
+			return true;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+		
+		//Last sequence has no match
+		if (ip == ip_end)
+			break;
+		
+		//Copy match
+		if (ip_end - ip < 2)
+			return true;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return true;
+		
+		len = token & 0xF;
+		if (len == 15)
+		{
+			u8 add;
+			do
+			{
+				if (ip >= ip_end)
+					return true;
+				len += (add = *ip++);
+			} while (add == 255);
+		}
+		len += 4;
+		if (len > (size_t)(op_end - op))
+			return true;
+		
+		const u8 *ref = op - offset;
+		if (offset >= len)
+		{
+			memcpy(op, ref, len);
+			op += len;
+		}
+		else
+		{
+			while (len-- > 0)
+				*op++ = *ref++;
+		}
+	}
+	
+	return op != op_end;
+}
+
+static boolean IO_Expand(u8 *data, size_t size, const u8 *src, size_t src_size)
+{
+	//Copy directory, its positions are already for the expanded archive
+	if (src_size < 16)
+		return true;
+	u32 files = IO_Get32(src + 8);
+	size_t dir_size = IO_Get32(src + 12); //Includes the hash index if there is one
+	if (dir_size == 0)
+		dir_size = (size_t)files * 16;
+	if (dir_size > size || 16 + dir_size > src_size)
+		return true;
+	memcpy(data, src + 16, dir_size);
+	
+	//Decompress each file straight into place
+	const u8 *srcp = src + 16 + dir_size, *src_end = src + src_size;
+	size_t end = dir_size;
+	for (u32 i = 0; i < files; i++)
+	{
+		size_t pos = IO_Get32(data + i * 16 + 12);
+		if (src_end - srcp < 12)
+			return true;
+		size_t file_size = IO_Get32(srcp);
+		size_t packed = IO_Get32(srcp + 4);
+		u32 method = IO_Get32(srcp + 8);
+		srcp += 12;
+		if (pos < end || pos > size || file_size > size - pos || packed > (size_t)(src_end - srcp))
+			return true;
+		
+		//Clear padding between files
+		memset(data + end, 0, pos - end);
+		end = pos + file_size;
+		
+		switch (method)
+		{
+			case IO_ARC_METHOD_STORE:
+				if (packed != file_size)
+					return true;
+				memcpy(data + pos, srcp, file_size);
+				break;
+			case IO_ARC_METHOD_LZ4:
+				if (IO_LZ4Decode(data + pos, file_size, srcp, packed))
+					return true;
+				break;
+			default:
+				return true;
+		}
+		srcp += packed;
+	}
+	memset(data + end, 0, size - end);
+	
+	return false;
+}
+
+static boolean IO_ReadSource(IO_Source *source, void *data)
+{
+	boolean fail;
+	if (source->expand != 0)
+	{
+		//Read compressed file to the side and expand it into the buffer, system malloc is safe from the worker
+		u8 *packed = malloc(source->size);
+		fail = packed == NULL || IO_ReadRaw(source, packed, 0, source->size);
+		if (!fail && source->block)
+			fail = IO_LZ4Decode((u8*)data, source->expand, packed, source->size);
+		else if (!fail)
+			fail = IO_Expand((u8*)data, source->expand, packed, source->size);
+		free(packed);
+	}
+	else
+	{
+		fail = IO_ReadRaw(source, data, 0, source->size);
+	}
+	
+	if (source->fp != NULL)
+		fclose(source->fp);
+	return fail;
+}
+
+#ifdef IO_ASYNC
+
+//Asynchronous read queue
+typedef struct
+{
+	CdlFILE file; //Kept for reporting failures
+	IO_Source source;
+	IO_Data data;
+	boolean busy; //Set until the read has finished
+} IO_Request;
+
+static IO_Request io_queue[IO_ASYNC_MAX];
+static size_t io_queue_next, io_queue_tail; //Workers take from next, main thread pushes at tail
+static size_t io_queue_busy;
+static boolean io_quit;
+static char io_fail[80]; //Worker can't ErrorLock itself, the main thread reports for it
+
+#ifdef PSXF_WIN32
+	static HANDLE io_thread[IO_ASYNC_THREADS];
+	static CRITICAL_SECTION io_lock;
+	static CONDITION_VARIABLE io_cond_push, io_cond_done;
+	
+	#define IO_Lock() EnterCriticalSection(&io_lock)
+	#define IO_Unlock() LeaveCriticalSection(&io_lock)
+	#define IO_CondWait(cond) SleepConditionVariableCS(cond, &io_lock, INFINITE)
+	#define IO_CondWake(cond) WakeAllConditionVariable(cond)
+#else
+	static pthread_t io_thread[IO_ASYNC_THREADS];
+	static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+	static pthread_cond_t io_cond_push = PTHREAD_COND_INITIALIZER, io_cond_done = PTHREAD_COND_INITIALIZER;
+	
+	#define IO_Lock() pthread_mutex_lock(&io_lock)
+	#define IO_Unlock() pthread_mutex_unlock(&io_lock)
+	#define IO_CondWait(cond) pthread_cond_wait(cond, &io_lock)
+	#define IO_CondWake(cond) pthread_cond_broadcast(cond)
+#endif
+
+#ifdef PSXF_WIN32
+static DWORD WINAPI IO_AsyncThread(LPVOID user)
+#else
+static void *IO_AsyncThread(void *user)
+#endif
+{
+	(void)user;
+	
+	IO_Lock();
+	while (1)
+	{
+		//Wait for a request
+		while (io_queue_next == io_queue_tail && !io_quit)
+			IO_CondWait(&io_cond_push);
+		if (io_queue_next == io_queue_tail)
+			break;
+		IO_Request *req = &io_queue[io_queue_next++ % IO_ASYNC_MAX];
+		IO_Unlock();
+		
+		//Read file without holding the lock, the slot can't be reused while it's busy
+		boolean fail = IO_ReadSource(&req->source, req->data);
+		
+		//Retire request
+		IO_Lock();
+		if (fail && io_fail[0] == '\0')
+			snprintf(io_fail, sizeof(io_fail), "\"%s\" (size 0x%X)", req->file.path, (unsigned int)req->source.size);
+		req->busy = false;
+		io_queue_busy--;
+		IO_CondWake(&io_cond_done);
+	}
+	IO_Unlock();
+	
+	return 0;
+}
+
+static void IO_Queue(CdlFILE *file, IO_Source *source, IO_Data data)
+{
+	//Queue read, waiting for room if needed
+	IO_Lock();
+	while (io_queue[io_queue_tail % IO_ASYNC_MAX].busy)
+		IO_CondWait(&io_cond_done);
+	IO_Request *req = &io_queue[io_queue_tail++ % IO_ASYNC_MAX];
+	req->file = *file;
+	req->source = *source;
+	req->data = data;
+	req->busy = true;
+	io_queue_busy++;
+	IO_CondWake(&io_cond_push);
+	IO_Unlock();
+}
+
+static boolean IO_Pending(IO_Data data)
+{
+	//Look for the buffer among unfinished reads, lock must be held
+	for (size_t i = 0; i < IO_ASYNC_MAX; i++)
+		if (io_queue[i].busy && io_queue[i].data == data)
+			return true;
+	return false;
+}
+
+static void IO_CheckAsync(void)
+{
+	//Report failed reads on the main thread
+	if (io_fail[0] != '\0')
+	{
+		sprintf(error_msg, "[IO_AsyncReadFile] Failed to read %s", io_fail);
+		io_fail[0] = '\0';
+		ErrorLock();
+	}
+}
+
+//Prefetched files
+static struct
+{
+	CdlFILE file;
+	IO_Data data; //NULL if the slot is free
+	size_t size;
+	size_t heap; //Heap used by the buffer, 0 if mapped
+} io_prefetch[IO_PREFETCH_MAX];
+
+static size_t io_prefetch_heap;
+
+static IO_Data IO_PrefetchClaim(CdlFILE *file, size_t *size)
+{
+	//Hand over a prefetched buffer, the caller owns it from here
+	for (size_t i = 0; i < IO_PREFETCH_MAX; i++)
+	{
+		if (io_prefetch[i].data != NULL && strcmp(io_prefetch[i].file.path, file->path) == 0)
+		{
+			IO_Data data = io_prefetch[i].data;
+			*size = io_prefetch[i].size;
+			io_prefetch[i].data = NULL;
+			io_prefetch_heap -= io_prefetch[i].heap;
+			
+			//Count heap buffers under the reader's tag instead of IO, and give it to the reader's scope
+			if (io_prefetch[i].heap != 0)
+				Mem_Retag(data);
+			Mem_Adopt(data);
+			return data;
+		}
+	}
+	return NULL;
+}
+
+#endif
+
+//Read hook
+static void (*io_hook)(CdlFILE *file);
+
+//Load telemetry
+static IO_Stats io_stats;
+static boolean io_stats_active;
+
+static void IO_StatsFile(CdlFILE *file, size_t size, u8 how, double start)
+{
+	if (!io_stats_active)
+		return;
+	
+	//Add to totals
+	u32 us = (u32)((glfwGetTime() - start) * 1000000.0);
+	io_stats.files++;
+	io_stats.bytes += size;
+	io_stats.read_us += us;
+	if (how == IO_StatsHow_Prefetch)
+		io_stats.hits++;
+	else if (how == IO_StatsHow_Map)
+		io_stats.maps++;
+	
+	//Remember file
+	if (io_stats.file_num < IO_STATS_FILES)
+	{
+		strcpy(io_stats.file[io_stats.file_num].path, file->path);
+		io_stats.file[io_stats.file_num].bytes = size;
+		io_stats.file[io_stats.file_num].us = us;
+		io_stats.file[io_stats.file_num].how = how;
+		io_stats.file_num++;
+	}
+}
+
 //IO functions
 void IO_Init(void)
 {
@@ -40,25 +896,121 @@ void IO_Init(void)
 			strcat(iso_dir, "ISO/");
 		}
 	}
+	
+	#ifdef IO_MMAP
+		//Let Mem_Free release mapped files
+		for (size_t i = 0; i < IO_MMAP_MAX; i++)
+			io_maps[i].ptr = NULL;
+		Mem_SetForeign(IO_Unmap);
+		
+		#ifdef PSXF_WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			io_map_align = info.dwAllocationGranularity;
+		#else
+			io_map_align = sysconf(_SC_PAGESIZE);
+		#endif
+	#endif
+	
+	#ifdef IO_PAK
+		//Mount asset bundle
+		IO_PakMount();
+	#endif
+	
+	#ifdef IO_INDEX
+		//Index files so IO_FindFile doesn't have to go to the filesystem
+		IO_IndexBuild();
+	#endif
+	
+	#ifdef IO_ASYNC
+		//Start read workers
+		io_queue_next = io_queue_tail = 0;
+		io_queue_busy = 0;
+		for (size_t i = 0; i < IO_ASYNC_MAX; i++)
+			io_queue[i].busy = false;
+		io_quit = false;
+		io_fail[0] = '\0';
+		#ifdef PSXF_WIN32
+			InitializeCriticalSection(&io_lock);
+			InitializeConditionVariable(&io_cond_push);
+			InitializeConditionVariable(&io_cond_done);
+		#endif
+		for (size_t i = 0; i < IO_ASYNC_THREADS; i++)
+		{
+			#ifdef PSXF_WIN32
+				if ((io_thread[i] = CreateThread(NULL, 0, IO_AsyncThread, NULL, 0, NULL)) == NULL)
+			#else
+				if (pthread_create(&io_thread[i], NULL, IO_AsyncThread, NULL) != 0)
+			#endif
+			{
+				sprintf(error_msg, "[IO_Init] Failed to start read thread");
+				ErrorLock();
+			}
+		}
+	#endif
 }
 
 void IO_Quit(void)
 {
+	#ifdef IO_ASYNC
+		//Drop prefetched files
+		IO_PrefetchClear();
+		
+		//Finish queued reads and stop workers
+		IO_Lock();
+		io_quit = true;
+		IO_CondWake(&io_cond_push);
+		IO_Unlock();
+		for (size_t i = 0; i < IO_ASYNC_THREADS; i++)
+		{
+			#ifdef PSXF_WIN32
+				WaitForSingleObject(io_thread[i], INFINITE);
+				CloseHandle(io_thread[i]);
+			#else
+				pthread_join(io_thread[i], NULL);
+			#endif
+		}
+		#ifdef PSXF_WIN32
+			DeleteCriticalSection(&io_lock);
+		#endif
+	#endif
+	
+	#ifdef IO_MMAP
+		//Release leftover mappings
+		for (size_t i = 0; i < IO_MMAP_MAX; i++)
+			if (io_maps[i].ptr != NULL)
+				IO_Unmap(io_maps[i].ptr);
+		Mem_SetForeign(NULL);
+	#endif
+	
+	#ifdef IO_PAK
+		//Unmount asset bundle
+		if (io_pak_mounted)
+			IO_PakClose();
+	#endif
+	
+	#ifdef IO_INDEX
+		//Drop directory index
+		IO_IndexFree();
+	#endif
+	
 	free(iso_dir);
 }
 
 void IO_FindFile(CdlFILE *file, const char *path)
 {
 	//Empty path
+	file->handle = 0;
 	if (path == NULL || path[0] == '\0')
 	{
 		file->path[0] = '\0';
 		return;
 	}
 	
-	//Reformat path
+	//Reformat path, hashing it as it's written
 	char *outp = file->path;
 	const char *pathp = path + 1;
+	u32 hash = 0x811C9DC5;
 	for (size_t i = sizeof(file->path) - 1; i > 0; i--, outp++, pathp++)
 	{
 		if (*pathp == '\0' || *pathp == ';')
@@ -67,8 +1019,16 @@ void IO_FindFile(CdlFILE *file, const char *path)
 			*outp = '/';
 		else
 			*outp = *pathp;
+		hash = IO_PathHashChar(hash, *outp);
 	}
 	*outp = '\0';
+	
+	#ifdef IO_INDEX
+		//Resolve file from the index
+		file->handle = IO_IndexProbe(hash, file->path);
+	#else
+		(void)hash;
+	#endif
 }
 
 void IO_SeekFile(CdlFILE *file)
@@ -76,82 +1036,240 @@ void IO_SeekFile(CdlFILE *file)
 	(void)file;
 }
 
+//Returns NULL without reporting anything, the audio prefetch thread opens files too
 FILE *IO_OpenFile(CdlFILE *file)
 {
-	//Get joined path
-	char *join;
-	if (iso_dir != NULL)
-	{
-		join = malloc(strlen(iso_dir) + strlen(file->path) + 1);
-		if (join == NULL)
+	//Get host path, indexed files already have theirs
+	const char *host;
+	char join[IO_INDEX_PATH];
+	#ifdef IO_INDEX
+		if (file->handle != 0 && io_index[file->handle - 1].pak == 0)
 		{
-			sprintf(error_msg, "[IO_OpenFile] Failed to allocate joined path");
-			ErrorLock();
-			return NULL;
+			host = io_index_names + io_index[file->handle - 1].name;
 		}
-		sprintf(join, "%s%s", iso_dir, file->path);
-	}
-	else
+		else
+	#endif
 	{
-		join = malloc(strlen(file->path) + 1);
-		if (join == NULL)
-		{
-			sprintf(error_msg, "[IO_OpenFile] Failed to allocate joined path");
-			ErrorLock();
+		const char *dir = (iso_dir != NULL) ? iso_dir : "";
+		size_t dir_len = strlen(dir), path_len = strlen(file->path);
+		if (dir_len + path_len + 1 > sizeof(join))
 			return NULL;
-		}
-		strcpy(join, file->path);
+		memcpy(join, dir, dir_len);
+		memcpy(join + dir_len, file->path, path_len + 1);
+		host = join;
 	}
 	
 	//Open file
-	FILE *fp = fopen(join, "rb");
-	free(join);
-	if (fp == NULL)
+	return fopen(host, "rb");
+}
+
+static boolean IO_OpenSource(IO_Source *source, CdlFILE *file, boolean report)
+{
+	//Failures are only reported if asked, speculative reads are allowed to miss
+	source->expand = 0;
+	source->block = false;
+	
+	#ifdef IO_PAK
+		//Look for file in the bundle
+		const IO_PakEntry *entry;
+		#ifdef IO_INDEX
+			if (file->handle != 0)
+				entry = io_index[file->handle - 1].pak ? &io_pak_entry[io_index[file->handle - 1].pak - 1] : NULL;
+			else
+		#endif
+				entry = IO_PakFind(file->path);
+		if (entry != NULL)
+		{
+			source->fp = NULL;
+			source->pos = (size_t)entry->pos * IO_SECT_SIZE;
+			switch (entry->method)
+			{
+				case IO_PAK_METHOD_STORE:
+					source->size = entry->size;
+					break;
+				case IO_PAK_METHOD_LZ4:
+					source->size = entry->packed;
+					source->expand = entry->size;
+					source->block = true;
+					break;
+				default:
+					if (report)
+					{
+						sprintf(error_msg, "[IO_OpenSource] \"%s\" uses unsupported compression %u", file->path, (unsigned int)entry->method);
+						ErrorLock();
+					}
+					return true;
+			}
+		}
+		else
+	#endif
 	{
-		sprintf(error_msg, "[IO_OpenFile] Failed to open \"%s\"", file->path);
-		ErrorLock();
-		return NULL;
+		//Open loose file
+		if ((source->fp = IO_OpenFile(file)) == NULL)
+		{
+			if (report)
+			{
+				sprintf(error_msg, "[IO_OpenSource] Failed to open \"%s\"", file->path);
+				ErrorLock();
+			}
+			return true;
+		}
+		source->pos = 0;
+		#ifdef IO_INDEX
+			if (file->handle != 0)
+			{
+				source->size = io_index[file->handle - 1].size;
+			}
+			else
+		#endif
+		{
+			fseek(source->fp, 0, SEEK_END);
+			source->size = ftell(source->fp);
+		}
 	}
 	
-	return fp;
+	//Check for compressed archive
+	u8 header[8];
+	if (source->expand == 0 && source->size >= 16 && !IO_ReadRaw(source, header, 0, sizeof(header)) && memcmp(header, "FARZ", 4) == 0)
+		source->expand = IO_Get32(header + 4);
+	return false;
+}
+
+static IO_Data IO_MapSource(IO_Source *source)
+{
+	#ifdef IO_MMAP
+		//Map large files straight into memory
+		if (source->expand == 0 && source->size >= IO_MMAP_MIN)
+		{
+			IO_Data map;
+			#ifdef IO_PAK
+				if (source->fp == NULL)
+					map = IO_Map(io_pak, source->pos, source->size);
+				else
+			#endif
+					map = IO_Map(IO_NativeOf(source->fp), 0, source->size);
+			
+			if (map != NULL)
+			{
+				//Have the open scope unmap it when it's popped
+				if (source->fp != NULL)
+					fclose(source->fp);
+				Mem_Adopt(map);
+				return map;
+			}
+		}
+	#else
+		(void)source;
+	#endif
+	return NULL;
 }
 
 IO_Data IO_ReadFile(CdlFILE *file)
 {
+	double start = glfwGetTime();
+	
+	if (io_hook != NULL)
+		io_hook(file);
+	
+	#ifdef IO_ASYNC
+		//Take prefetched file once it's finished reading
+		size_t prefetch_size;
+		IO_Data prefetch = IO_PrefetchClaim(file, &prefetch_size);
+		if (prefetch != NULL)
+		{
+			IO_Lock();
+			while (IO_Pending(prefetch))
+				IO_CondWait(&io_cond_done);
+			IO_Unlock();
+			IO_CheckAsync();
+			IO_StatsFile(file, prefetch_size, IO_StatsHow_Prefetch, start);
+			return prefetch;
+		}
+	#endif
+	
 	//Open file
-	FILE *fp = IO_OpenFile(file);
-	if (fp == NULL)
+	IO_Source source;
+	if (IO_OpenSource(&source, file, true))
 		return NULL;
 	
+	//Map large files
+	IO_Data data = IO_MapSource(&source);
+	if (data != NULL)
+	{
+		IO_StatsFile(file, source.size, IO_StatsHow_Map, start);
+		return data;
+	}
+	
 	//Allocate buffer
-	fseek(fp, 0, SEEK_END);
-	size_t size = ftell(fp);
-	IO_Data data = Mem_Alloc(size);
-	if (data == NULL)
+	size_t size = (source.expand != 0) ? source.expand : source.size;
+	if ((data = Mem_Alloc(size)) == NULL)
 	{
-		fclose(fp);
+		if (source.fp != NULL)
+			fclose(source.fp);
 		sprintf(error_msg, "[IO_ReadFile] Failed to allocate data buffer (size 0x%X)", (unsigned int)size);
 		ErrorLock();
 		return NULL;
 	}
-	fseek(fp, 0, SEEK_SET);
 	
 	//Read buffer
-	if (fread(data, size, 1, fp) != 1)
+	if (IO_ReadSource(&source, data))
 	{
-		fclose(fp);
-		sprintf(error_msg, "[IO_ReadFile] Failed to allocate data buffer (size 0x%X)", (unsigned int)size);
+		sprintf(error_msg, "[IO_ReadFile] Failed to read \"%s\" (size 0x%X)", file->path, (unsigned int)source.size);
 		ErrorLock();
 		return NULL;
 	}
-	fclose(fp);
 	
+	IO_StatsFile(file, size, IO_StatsHow_Read, start);
 	return data;
 }
 
 IO_Data IO_AsyncReadFile(CdlFILE *file)
 {
-	return IO_ReadFile(file);
+	#ifdef IO_ASYNC
+		double start = glfwGetTime();
+		
+		if (io_hook != NULL)
+			io_hook(file);
+		
+		//Take prefetched file, it's already on its way
+		size_t prefetch_size;
+		IO_Data prefetch = IO_PrefetchClaim(file, &prefetch_size);
+		if (prefetch != NULL)
+		{
+			IO_StatsFile(file, prefetch_size, IO_StatsHow_Prefetch, start);
+			return prefetch;
+		}
+		
+		//Open file
+		IO_Source source;
+		if (IO_OpenSource(&source, file, true))
+			return NULL;
+		
+		//Mapped files are complete immediately, IO_Map has the OS start paging them in
+		IO_Data data = IO_MapSource(&source);
+		if (data != NULL)
+		{
+			IO_StatsFile(file, source.size, IO_StatsHow_Map, start);
+			return data;
+		}
+		
+		//Allocate buffer here, the heap isn't thread safe
+		size_t size = (source.expand != 0) ? source.expand : source.size;
+		if ((data = Mem_Alloc(size)) == NULL)
+		{
+			if (source.fp != NULL)
+				fclose(source.fp);
+			sprintf(error_msg, "[IO_AsyncReadFile] Failed to allocate data buffer (size 0x%X)", (unsigned int)size);
+			ErrorLock();
+			return NULL;
+		}
+		
+		IO_Queue(file, &source, data);
+		IO_StatsFile(file, size, IO_StatsHow_Async, start);
+		return data;
+	#else
+		return IO_ReadFile(file);
+	#endif
 }
 
 IO_Data IO_Read(const char *path)
@@ -168,6 +1286,106 @@ IO_Data IO_AsyncRead(const char *path)
 	return IO_AsyncReadFile(&file);
 }
 
+void IO_ReadBatch(const char **paths, IO_Data *out, size_t n)
+{
+	//Queue every file so the workers read them at once
+	for (size_t i = 0; i < n; i++)
+		out[i] = (paths[i] != NULL) ? IO_AsyncRead(paths[i]) : NULL;
+	
+	#ifdef IO_ASYNC
+		//Wait for just these files, prefetches can keep going
+		IO_Lock();
+		for (size_t i = 0; i < n; i++)
+			while (out[i] != NULL && IO_Pending(out[i]))
+				IO_CondWait(&io_cond_done);
+		IO_Unlock();
+		IO_CheckAsync();
+	#endif
+}
+
+static boolean IO_OpenPart(IO_Source *source, CdlFILE *file, size_t pos, size_t size)
+{
+	//Narrow the source down to part of the file, compressed archives can only be read whole
+	if (IO_OpenSource(source, file, true))
+		return true;
+	if (source->expand != 0)
+	{
+		if (source->fp != NULL)
+			fclose(source->fp);
+		sprintf(error_msg, "[IO_OpenPart] Can't read part of compressed \"%s\"", file->path);
+		ErrorLock();
+		return true;
+	}
+	if (pos > source->size)
+		pos = source->size;
+	if (size > source->size - pos)
+		size = source->size - pos;
+	source->pos += pos;
+	source->size = size;
+	return false;
+}
+
+IO_Data IO_ReadPart(CdlFILE *file, size_t pos, size_t size)
+{
+	double start = glfwGetTime();
+	
+	//Open part
+	IO_Source source;
+	if (IO_OpenPart(&source, file, pos, size))
+		return NULL;
+	
+	//Allocate buffer
+	IO_Data data;
+	if ((data = Mem_Alloc(source.size)) == NULL)
+	{
+		if (source.fp != NULL)
+			fclose(source.fp);
+		sprintf(error_msg, "[IO_ReadPart] Failed to allocate data buffer (size 0x%X)", (unsigned int)source.size);
+		ErrorLock();
+		return NULL;
+	}
+	
+	//Read buffer
+	if (IO_ReadSource(&source, data))
+	{
+		sprintf(error_msg, "[IO_ReadPart] Failed to read \"%s\" (size 0x%X)", file->path, (unsigned int)source.size);
+		ErrorLock();
+		return NULL;
+	}
+	
+	IO_StatsFile(file, source.size, IO_StatsHow_Read, start);
+	return data;
+}
+
+IO_Data IO_AsyncReadPart(CdlFILE *file, size_t pos, size_t size)
+{
+	#ifdef IO_ASYNC
+		double start = glfwGetTime();
+		
+		//Open part
+		IO_Source source;
+		if (IO_OpenPart(&source, file, pos, size))
+			return NULL;
+		
+		//Allocate buffer here, the heap isn't thread safe
+		IO_Data data;
+		if ((data = Mem_Alloc(source.size)) == NULL)
+		{
+			if (source.fp != NULL)
+				fclose(source.fp);
+			sprintf(error_msg, "[IO_AsyncReadPart] Failed to allocate data buffer (size 0x%X)", (unsigned int)source.size);
+			ErrorLock();
+			return NULL;
+		}
+		
+		IO_Queue(file, &source, data);
+		IO_StatsFile(file, source.size, IO_StatsHow_Async, start);
+		return data;
+	#else
+		return IO_ReadPart(file, pos, size);
+	#endif
+}
+
 boolean IO_IsSeeking(void)
 {
 	return false;
@@ -175,5 +1393,178 @@ boolean IO_IsSeeking(void)
 
 boolean IO_IsReading(void)
 {
-	return false;
+	#ifdef IO_ASYNC
+		IO_Lock();
+		boolean reading = io_queue_busy != 0;
+		IO_Unlock();
+		IO_CheckAsync();
+		return reading;
+	#else
+		return false;
+	#endif
+}
+
+boolean IO_IsDone(IO_Data data)
+{
+	#ifdef IO_ASYNC
+		IO_Lock();
+		boolean done = !IO_Pending(data);
+		IO_Unlock();
+		IO_CheckAsync();
+		return done;
+	#else
+		(void)data;
+		return true;
+	#endif
+}
+
+void IO_Wait(void)
+{
+	#ifdef IO_ASYNC
+		IO_Lock();
+		while (io_queue_busy != 0)
+			IO_CondWait(&io_cond_done);
+		IO_Unlock();
+		IO_CheckAsync();
+	#endif
+}
+
+void IO_Prefetch(CdlFILE *file)
+{
+	#ifdef IO_ASYNC
+		//Find a free slot, unless the file is already coming
+		size_t slot = IO_PREFETCH_MAX;
+		for (size_t i = 0; i < IO_PREFETCH_MAX; i++)
+		{
+			if (io_prefetch[i].data == NULL)
+			{
+				if (slot == IO_PREFETCH_MAX)
+					slot = i;
+			}
+			else if (strcmp(io_prefetch[i].file.path, file->path) == 0)
+			{
+				return;
+			}
+		}
+		if (slot == IO_PREFETCH_MAX)
+			return;
+		
+		//Open file, a file that isn't there just isn't prefetched
+		IO_Source source;
+		if (IO_OpenSource(&source, file, false))
+			return;
+		io_prefetch[slot].file = *file;
+		io_prefetch[slot].size = (source.expand != 0) ? source.expand : source.size;
+		io_prefetch[slot].heap = 0;
+		
+		//Mapped files don't take any heap
+		if ((io_prefetch[slot].data = IO_MapSource(&source)) != NULL)
+			return;
+		
+		//Allocate buffer if it fits in the budget, it's fine to give up here
+		size_t size = (source.expand != 0) ? source.expand : source.size;
+		int tag = Mem_SetTag(MemTag_IO);
+		io_prefetch[slot].data = (io_prefetch_heap + size <= IO_PREFETCH_BUDGET) ? Mem_Alloc(size) : NULL;
+		Mem_SetTag(tag);
+		if (io_prefetch[slot].data == NULL)
+		{
+			if (source.fp != NULL)
+				fclose(source.fp);
+			return;
+		}
+		io_prefetch[slot].heap = size;
+		io_prefetch_heap += size;
+		
+		IO_Queue(file, &source, io_prefetch[slot].data);
+	#else
+		(void)file;
+	#endif
+}
+
+void IO_PrefetchClear(void)
+{
+	#ifdef IO_ASYNC
+		//Free prefetched files nobody asked for
+		for (size_t i = 0; i < IO_PREFETCH_MAX; i++)
+		{
+			if (io_prefetch[i].data == NULL)
+				continue;
+			IO_Lock();
+			while (IO_Pending(io_prefetch[i].data))
+				IO_CondWait(&io_cond_done);
+			IO_Unlock();
+			Mem_Free(io_prefetch[i].data);
+			io_prefetch[i].data = NULL;
+		}
+		io_prefetch_heap = 0;
+	#endif
+}
+
+void IO_SetReadHook(void (*hook)(CdlFILE *file))
+{
+	io_hook = hook;
+}
+
+void IO_StatsBegin(const char *name)
+{
+	//Start measuring a new load
+	memset(&io_stats, 0, sizeof(io_stats));
+	io_stats.name = name;
+	io_stats.start = glfwGetTime();
+	io_stats_active = true;
+}
+
+void IO_StatsEnd(void)
+{
+	if (!io_stats_active)
+		return;
+	io_stats.us = (u32)((glfwGetTime() - io_stats.start) * 1000000.0);
+	io_stats_active = false;
+	
+	#ifdef IO_STATS_PRINT
+		//Print summary and files
+		printf("[IO_Stats] %s took %u.%03ums\n", io_stats.name, (unsigned int)(io_stats.us / 1000), (unsigned int)(io_stats.us % 1000));
+		printf("  %u files, 0x%X bytes in %u.%03ums (%u prefetched, %u mapped)\n",
+			(unsigned int)io_stats.files, (unsigned int)io_stats.bytes,
+			(unsigned int)(io_stats.read_us / 1000), (unsigned int)(io_stats.read_us % 1000),
+			(unsigned int)io_stats.hits, (unsigned int)io_stats.maps
+		);
+		printf("  %u textures in %u.%03ums, %u archive finds in %u.%03ums\n",
+			(unsigned int)io_stats.texs, (unsigned int)(io_stats.tex_us / 1000), (unsigned int)(io_stats.tex_us % 1000),
+			(unsigned int)io_stats.finds, (unsigned int)(io_stats.find_us / 1000), (unsigned int)(io_stats.find_us % 1000)
+		);
+		static const char *how_str[] = {"read", "prefetch", "map", "async"};
+		for (u8 i = 0; i < io_stats.file_num; i++)
+			printf("    %-24s 0x%06X %5u.%03ums %s\n",
+				io_stats.file[i].path, (unsigned int)io_stats.file[i].bytes,
+				(unsigned int)(io_stats.file[i].us / 1000), (unsigned int)(io_stats.file[i].us % 1000),
+				how_str[io_stats.file[i].how]
+			);
+	#endif
+}
+
+const IO_Stats *IO_GetStats(void)
+{
+	return &io_stats;
+}
+
+double IO_StatsTime(void)
+{
+	return glfwGetTime();
+}
+
+void IO_StatsTex(double start)
+{
+	if (!io_stats_active)
+		return;
+	io_stats.texs++;
+	io_stats.tex_us += (u32)((glfwGetTime() - start) * 1000000.0);
+}
+
+void IO_StatsFind(double start)
+{
+	if (!io_stats_active)
+		return;
+	io_stats.finds++;
+	io_stats.find_us += (u32)((glfwGetTime() - start) * 1000000.0);
 }
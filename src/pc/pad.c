@@ -6,11 +6,14 @@
 
 #include "../pad.h"
 
+#include <string.h>
+
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 //Window
 extern GLFWwindow *window;
+extern double window_poll_time;
 
 //Pad state
 Pad pad_state, pad_state_2;
@@ -35,6 +38,37 @@ void Pad_TypeCallback(GLFWwindow *proc_window, unsigned int code)
 
 #endif
 
+//Tap log
+static double pad_taps[PAD_TAPS];
+static u8 pad_taps_num;
+
+static void Pad_KeyCallback(GLFWwindow *proc_window, int key, int scancode, int action, int mods)
+{
+	(void)scancode;
+	(void)mods;
+	
+	//Stamp direction presses, GLFW only calls us from glfwPollEvents in Gfx_Flip,
+	//so the press happened somewhere since the previous poll. Take the middle of
+	//that window so taps aren't all half a frame late on average
+	if (proc_window != window || action != GLFW_PRESS)
+		return;
+	if (key != GLFW_KEY_LEFT && key != GLFW_KEY_DOWN && key != GLFW_KEY_UP && key != GLFW_KEY_RIGHT)
+		return;
+	if (pad_taps_num < PAD_TAPS)
+		pad_taps[pad_taps_num++] = (window_poll_time + glfwGetTime()) / 2.0;
+}
+
+u8 Pad_GetTaps(double *times, u8 max)
+{
+	//Take logged taps
+	if (max > pad_taps_num)
+		max = pad_taps_num;
+	memcpy(times, pad_taps, max * sizeof(double));
+	memmove(pad_taps, pad_taps + max, (pad_taps_num - max) * sizeof(double));
+	pad_taps_num -= max;
+	return max;
+}
+
 //Pad functions
 void Pad_Init(void)
 {
@@ -45,6 +79,11 @@ void Pad_Init(void)
 	pad_state_2.held = pad_state_2.press = 0;
 	pad_state_2.left_x = pad_state_2.left_y = pad_state_2.right_x = pad_state_2.right_y = 0;
 	
+	//Set up tap log
+	pad_taps_num = 0;
+	window_poll_time = glfwGetTime();
+	glfwSetKeyCallback(window, Pad_KeyCallback);
+	
 	#ifdef PSXF_NETWORK
 		//Set up typing
 		pad_type[0] = pad_type_internal[0] = '\0';
@@ -38,6 +38,7 @@ extern char **my_argv;
 	
 	typedef struct {
 		char path[32];
+		u32 handle; //Resolved by IO_FindFile, 0 if the file isn't indexed
 	} CdlFILE;
 	
 	//Misc. functions
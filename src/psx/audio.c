@@ -176,6 +176,29 @@ void Audio_SeekXA_Track(XA_Track track)
 	IO_SeekFile(&file);
 }
 
+void Audio_PrefetchXA_Track(XA_Track track)
+{
+	//XA is streamed straight from the disc, nothing to prepare
+	(void)track;
+}
+
+void Audio_GetStats(Audio_Stats *stats)
+{
+	//The SPU mixes XA itself, there's no callback to measure
+	memset(stats, 0, sizeof(Audio_Stats));
+}
+
+s32 Audio_GetLatency(void)
+{
+	//No calibration on PSX
+	return 0;
+}
+
+void Audio_SetLatency(s32 latency)
+{
+	(void)latency;
+}
+
 void Audio_PauseXA(void)
 {
 	//Pause playing XA file
@@ -194,6 +217,12 @@ void Audio_ChannelXA(u8 channel)
 	XA_SetFilter(channel);
 }
 
+void Audio_SetRateXA(fixed_t rate)
+{
+	//XA can't be time-stretched
+	(void)rate;
+}
+
 s32 Audio_TellXA_Sector(void)
 {
 	//Get CD position
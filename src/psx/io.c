@@ -10,6 +10,9 @@
 #include "../audio.h"
 #include "../main.h"
 
+//IO constants
+#define IO_BATCH_MAX 8 //Files IO_ReadBatch can sort at once
+
 //IO functions
 void IO_Init(void)
 {
@@ -101,6 +104,82 @@ IO_Data IO_AsyncRead(const char *path)
 	return IO_AsyncReadFile(&file);
 }
 
+void IO_ReadBatch(const char **paths, IO_Data *out, size_t n)
+{
+	if (n > IO_BATCH_MAX)
+	{
+		sprintf(error_msg, "[IO_ReadBatch] Too many files (%d)", (int)n);
+		ErrorLock();
+		return;
+	}
+	
+	//Search for files, ordering them by position on the disc
+	CdlFILE file[IO_BATCH_MAX];
+	u32 pos[IO_BATCH_MAX];
+	u8 order[IO_BATCH_MAX];
+	size_t files = 0;
+	
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = NULL;
+		if (paths[i] == NULL)
+			continue;
+		IO_FindFile(&file[i], paths[i]);
+		pos[i] = CdPosToInt(&file[i].pos);
+		
+		size_t j = files++;
+		for (; j > 0 && pos[order[j - 1]] > pos[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+	
+	//Read files in one sweep across the disc
+	for (size_t i = 0; i < files; i++)
+	{
+		out[order[i]] = IO_AsyncReadFile(&file[order[i]]);
+		CdReadSync(0, NULL);
+	}
+}
+
+IO_Data IO_ReadPart(CdlFILE *file, size_t pos, size_t size)
+{
+	//Read part then sync
+	IO_Data buffer = IO_AsyncReadPart(file, pos, size);
+	CdReadSync(0, NULL);
+	return buffer;
+}
+
+IO_Data IO_AsyncReadPart(CdlFILE *file, size_t pos, size_t size)
+{
+	//Stop XA playback
+	Audio_StopXA();
+	
+	//Get number of sectors for what's left of the file, reading at least one
+	if (pos >= file->size)
+		size = 0;
+	else if (size > file->size - pos)
+		size = file->size - pos;
+	size_t sects = (size + IO_SECT_SIZE - 1) / IO_SECT_SIZE;
+	if (sects == 0)
+		sects = 1;
+	
+	//Allocate a buffer for the part
+	IO_Data buffer = (IO_Data)Mem_Alloc(size = (IO_SECT_SIZE * sects));
+	if (buffer == NULL)
+	{
+		sprintf(error_msg, "[IO_AsyncReadPart] Malloc (size %X) fail", size);
+		ErrorLock();
+		return NULL;
+	}
+	
+	//Read part
+	CdlLOC loc;
+	CdIntToPos(CdPosToInt(&file->pos) + pos / IO_SECT_SIZE, &loc);
+	CdControl(CdlSetloc, (u8*)&loc, NULL);
+	CdRead(sects, buffer, CdlModeSpeed);
+	return buffer;
+}
+
 boolean IO_IsSeeking(void)
 {
 	CdControl(CdlNop, NULL, NULL);
@@ -112,3 +191,15 @@ boolean IO_IsReading(void)
 	CdControl(CdlNop, NULL, NULL);
 	return (CdStatus() & (CdlStatSeek | CdlStatRead)) != 0;
 }
+
+boolean IO_IsDone(IO_Data data)
+{
+	//The drive only has one read in flight at a time
+	(void)data;
+	return !IO_IsReading();
+}
+
+void IO_Wait(void)
+{
+	CdReadSync(0, NULL);
+}
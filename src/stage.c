@@ -28,6 +28,18 @@
 
 //#define STAGE_FREECAM //Freecam
 
+#define STAGE_PREFETCH_MS 10000 //How far into a story song the next song's music starts being prepared
+
+#ifdef PSXF_PC
+ #define STAGE_PLAN //Remember what each background and character reads so whole stages can be read ahead
+#endif
+#define STAGE_PLAN_FUNCS 48 //Constructors remembered
+#define STAGE_PLAN_FILES 8  //Files remembered per constructor
+
+#define STAGE_POOL_WINDOW FIXED_DEC(72,60) //Seconds a combo lives for, splashes go sooner
+#define STAGE_POOL_SLACK  4        //Extra combos per player for misses
+#define STAGE_POOL_MIN    8        //Smallest combo pool, splash pools get 3 times this
+
 static const fixed_t note_x[8] = {
 	//BF
 	 FIXED_DEC(26,1) + FIXED_DEC(SCREEN_WIDEADD,4),
@@ -42,6 +54,14 @@ static const fixed_t note_x[8] = {
 };
 static const fixed_t note_y = FIXED_DEC(32 - SCREEN_HEIGHT2, 1);
 
+static const fixed_t stage_rates[StageRate_Max] = {
+	FIXED_UNIT,     //StageRate_Normal
+	FIXED_DEC(3,2), //StageRate_Fast
+	FIXED_DEC(2,1), //StageRate_Double
+	FIXED_DEC(1,2), //StageRate_Half
+	FIXED_DEC(3,4), //StageRate_Slow
+};
+
 static const u16 note_key[] = {INPUT_LEFT, INPUT_DOWN, INPUT_UP, INPUT_RIGHT};
 static const u8 note_anims[4][3] = {
 	{CharAnim_Left,  CharAnim_LeftAlt,  PlayerAnim_LeftMiss},
@@ -83,6 +103,78 @@ static const StageDef stage_defs[StageId_Max] = {
 //Stage state
 Stage stage;
 
+#ifdef STAGE_PLAN
+
+//Stage load planner
+typedef void (*StagePlanFunc)(void);
+
+static struct
+{
+	StagePlanFunc func;
+	u8 files;
+	CdlFILE file[STAGE_PLAN_FILES];
+} stage_plans[STAGE_PLAN_FUNCS];
+static u8 stage_plans_num;
+static s32 stage_plan_rec = -1;
+
+static void Stage_PlanHook(CdlFILE *file)
+{
+	//Remember file read by the constructor being recorded
+	if (stage_plan_rec < 0)
+		return;
+	u8 *files = &stage_plans[stage_plan_rec].files;
+	CdlFILE *planp = stage_plans[stage_plan_rec].file;
+	for (u8 i = 0; i < *files; i++)
+		if (strcmp(planp[i].path, file->path) == 0)
+			return;
+	if (*files < STAGE_PLAN_FILES)
+		planp[(*files)++] = *file;
+}
+
+static s32 Stage_PlanFind(StagePlanFunc func)
+{
+	for (u8 i = 0; i < stage_plans_num; i++)
+		if (stage_plans[i].func == func)
+			return i;
+	return -1;
+}
+
+static void Stage_PlanBegin(StagePlanFunc func)
+{
+	//Record from scratch every time so plans follow the constructors
+	s32 i = Stage_PlanFind(func);
+	if (i < 0)
+	{
+		if (stage_plans_num >= STAGE_PLAN_FUNCS)
+			return;
+		stage_plans[i = stage_plans_num++].func = func;
+	}
+	stage_plans[i].files = 0;
+	stage_plan_rec = i;
+	IO_SetReadHook(Stage_PlanHook);
+}
+
+static void Stage_PlanEnd(void)
+{
+	stage_plan_rec = -1;
+	IO_SetReadHook(NULL);
+}
+
+static void Stage_PlanPrefetch(StagePlanFunc func)
+{
+	//Read ahead whatever the constructor read last time
+	s32 i = Stage_PlanFind(func);
+	if (i < 0)
+		return;
+	for (u8 j = 0; j < stage_plans[i].files; j++)
+		IO_Prefetch(&stage_plans[i].file[j]);
+}
+
+#else
+	#define Stage_PlanBegin(func)
+	#define Stage_PlanEnd()
+#endif
+
 //Stage music functions
 static void Stage_StartVocal(void)
 {
@@ -175,6 +267,12 @@ static void Stage_ScrollCamera(void)
 }
 
 //Stage section functions
+static fixed_t Stage_GetCrochet(u16 bpm)
+{
+	//Scaled by the practice rate so scrolling follows the music
+	return FIXED_MUL(((fixed_t)bpm << FIXED_SHIFT) * 8 / 240, stage.rate); //15/12/24
+}
+
 static void Stage_ChangeBPM(u16 bpm, u16 step)
 {
 	//Update last BPM
@@ -186,7 +284,7 @@ static void Stage_ChangeBPM(u16 bpm, u16 step)
 	stage.step_base = step;
 	
 	//Get new crochet and times
-	stage.step_crochet = ((fixed_t)bpm << FIXED_SHIFT) * 8 / 240; //15/12/24
+	stage.step_crochet = Stage_GetCrochet(bpm);
 	stage.step_time = FIXED_DIV(FIXED_DEC(12,1), stage.step_crochet);
 	
 	//Get new crochet based values
@@ -195,47 +293,6 @@ static void Stage_ChangeBPM(u16 bpm, u16 step)
 	stage.early_sus_safe = stage.early_safe * 2 / 5;
 }
 
-static Section *Stage_GetPrevSection(Section *section)
-{
-	if (section > stage.sections)
-		return section - 1;
-	return NULL;
-}
-
-static u16 Stage_GetSectionStart(Section *section)
-{
-	Section *prev = Stage_GetPrevSection(section);
-	if (prev == NULL)
-		return 0;
-	return prev->end;
-}
-
-//Section scroll structure
-typedef struct
-{
-	fixed_t start;   //Seconds
-	fixed_t length;  //Seconds
-	u16 start_step;  //Sub-steps
-	u16 length_step; //Sub-steps
-	
-	fixed_t size; //Note height
-} SectionScroll;
-
-static void Stage_GetSectionScroll(SectionScroll *scroll, Section *section)
-{
-	//Get BPM
-	u16 bpm = section->flag & SECTION_FLAG_BPM_MASK;
-	
-	//Get section step info
-	scroll->start_step = Stage_GetSectionStart(section);
-	scroll->length_step = section->end - scroll->start_step;
-	
-	//Get section time length
-	scroll->length = (scroll->length_step * FIXED_DEC(15,1) / 12) * 24 / bpm;
-	
-	//Get note height
-	scroll->size = FIXED_MUL(stage.speed, scroll->length * (12 * 150) / scroll->length_step) + FIXED_UNIT;
-}
 
 //Note hit detection
 static u8 Stage_HitNote(PlayerState *this, u8 type, fixed_t offset)
@@ -320,11 +377,28 @@ static void Stage_MissNote(PlayerState *this)
 	}
 }
 
+static u16 *Stage_LaneFirst(u8 lane, fixed_t late_safe)
+{
+	//Move the lane's cursor past notes that were hit or can't be hit anymore
+	u16 *lane_p = stage.lane_notes + stage.lane_cur[lane];
+	u16 *lane_end = stage.lane_notes + stage.lane_start[lane + 1];
+	for (; lane_p != lane_end; lane_p++)
+	{
+		Note *note = &stage.notes[*lane_p];
+		if (!(note->type & NOTE_FLAG_HIT) && ((fixed_t)note->pos << FIXED_SHIFT) + late_safe >= stage.note_scroll)
+			break;
+	}
+	stage.lane_cur[lane] = lane_p - stage.lane_notes;
+	return lane_p;
+}
+
 static void Stage_NoteCheck(PlayerState *this, u8 type)
 {
-	//Perform note check
-	for (Note *note = stage.cur_note;; note++)
+	//Perform note check on the taps and mines of this lane
+	u16 *lane_end = stage.lane_notes + stage.lane_start[type + 1];
+	for (u16 *lane_p = Stage_LaneFirst(type, stage.late_safe); lane_p != lane_end; lane_p++)
 	{
+		Note *note = &stage.notes[*lane_p];
 		if (!(note->type & NOTE_FLAG_MINE))
 		{
 			//Check if note can be hit
@@ -333,7 +407,7 @@ static void Stage_NoteCheck(PlayerState *this, u8 type)
 				break;
 			if (note_fp + stage.late_safe < stage.note_scroll)
 				continue;
-			if ((note->type & NOTE_FLAG_HIT) || (note->type & (NOTE_FLAG_OPPONENT | 0x3)) != type || (note->type & NOTE_FLAG_SUSTAIN))
+			if (note->type & NOTE_FLAG_HIT)
 				continue;
 			
 			//Hit the note
@@ -379,7 +453,7 @@ static void Stage_NoteCheck(PlayerState *this, u8 type)
 				break;
 			if (note_fp + (stage.late_safe * 2 / 5) < stage.note_scroll)
 				continue;
-			if ((note->type & NOTE_FLAG_HIT) || (note->type & (NOTE_FLAG_OPPONENT | 0x3)) != type || (note->type & NOTE_FLAG_SUSTAIN))
+			if (note->type & NOTE_FLAG_HIT)
 				continue;
 			
 			//Hit the mine
@@ -461,16 +535,19 @@ static void Stage_NoteCheck(PlayerState *this, u8 type)
 
 static void Stage_SustainCheck(PlayerState *this, u8 type)
 {
-	//Perform note check
-	for (Note *note = stage.cur_note;; note++)
+	//Perform note check on the sustains of this lane
+	u8 lane = type | NOTE_FLAG_SUSTAIN;
+	u16 *lane_end = stage.lane_notes + stage.lane_start[lane + 1];
+	for (u16 *lane_p = Stage_LaneFirst(lane, stage.late_sus_safe); lane_p != lane_end; lane_p++)
 	{
 		//Check if note can be hit
+		Note *note = &stage.notes[*lane_p];
 		fixed_t note_fp = (fixed_t)note->pos << FIXED_SHIFT;
 		if (note_fp - stage.early_sus_safe > stage.note_scroll)
 			break;
 		if (note_fp + stage.late_sus_safe < stage.note_scroll)
 			continue;
-		if ((note->type & NOTE_FLAG_HIT) || (note->type & (NOTE_FLAG_OPPONENT | 0x3)) != type || !(note->type & NOTE_FLAG_SUSTAIN))
+		if (note->type & NOTE_FLAG_HIT)
 			continue;
 		
 		//Hit the note
@@ -797,240 +874,227 @@ static void Stage_DrawStrum(u8 i, RECT *note_src, RECT_FIXED *note_dst)
 	}
 }
 
+static fixed_t Stage_GetNoteY(fixed_t time)
+{
+	return note_y + FIXED_MUL(stage.speed, (time - stage.song_time) * 150);
+}
+
 static void Stage_DrawNotes(void)
 {
 	//Check if opponent should draw as bot
 	u8 bot = (stage.mode >= StageMode_2P) ? 0 : NOTE_FLAG_OPPONENT;
 	
-	//Initialize scroll state
-	SectionScroll scroll;
-	scroll.start = stage.time_base;
-	
-	Section *scroll_section = stage.section_base;
-	Stage_GetSectionScroll(&scroll, scroll_section);
-	
-	//Push scroll back until cur_note is properly contained
-	while (scroll.start_step > stage.cur_note->pos)
+	//Miss notes that went above the screen and out of late time
+	const fixed_t top_y = FIXED_DEC(-16 - SCREEN_HEIGHT2, 1);
+	for (Note *note = stage.cur_note; note->pos != 0xFFFF; note = ++stage.cur_note)
 	{
-		//Look for previous section
-		Section *prev_section = Stage_GetPrevSection(scroll_section);
-		if (prev_section == NULL)
+		if (Stage_GetNoteY(stage.note_times[note - stage.notes].time) >= top_y || ((fixed_t)note->pos << FIXED_SHIFT) + stage.late_safe >= stage.note_scroll)
 			break;
 		
-		//Push scroll back
-		scroll_section = prev_section;
-		Stage_GetSectionScroll(&scroll, scroll_section);
-		scroll.start -= scroll.length;
+		//Get note information
+		u8 i = (note->type & NOTE_FLAG_OPPONENT) != 0;
+		PlayerState *this = &stage.player_state[i];
+		
+		//Miss note if player's note
+		if (!(note->type & (bot | NOTE_FLAG_HIT | NOTE_FLAG_MINE)))
+		{
+			if (stage.mode < StageMode_Net1 || i == ((stage.mode == StageMode_Net1) ? 0 : 1))
+			{
+				//Missed note
+				Stage_CutVocal();
+				Stage_MissNote(this);
+				this->health -= 475;
+				
+				//Send miss packet
+				#ifdef PSXF_NETWORK
+					if (stage.mode >= StageMode_Net1)
+					{
+						//Send note hit packet
+						Packet note_hit;
+						note_hit[0] = PacketType_NoteMiss;
+						note_hit[1] = 0xFF;
+						
+						note_hit[2] = this->score >> 0;
+						note_hit[3] = this->score >> 8;
+						note_hit[4] = this->score >> 16;
+						note_hit[5] = this->score >> 24;
+						
+						Network_Send(&note_hit);
+					}
+				#endif
+			}
+		}
+	}
+	
+	//Find the first note below the top of the screen, the ones before it are waiting out their late time
+	size_t note_lo = stage.cur_note - stage.notes;
+	size_t note_hi = stage.num_notes;
+	while (note_lo < note_hi)
+	{
+		size_t note_mid = (note_lo + note_hi) >> 1;
+		if (Stage_GetNoteY(stage.note_times[note_mid].time) < top_y)
+			note_lo = note_mid + 1;
+		else
+			note_hi = note_mid;
 	}
 	
 	//Draw notes
-	for (Note *note = stage.cur_note; note->pos != 0xFFFF; note++)
+	for (Note *note = &stage.notes[note_lo]; note->pos != 0xFFFF; note++)
 	{
-		//Update scroll
-		while (note->pos >= scroll_section->end)
-		{
-			//Push scroll forward
-			scroll.start += scroll.length;
-			Stage_GetSectionScroll(&scroll, ++scroll_section);
-		}
-		
 		//Get note information
 		u8 i = (note->type & NOTE_FLAG_OPPONENT) != 0;
 		PlayerState *this = &stage.player_state[i];
 		
+		NoteTime *note_time = &stage.note_times[note - stage.notes];
 		fixed_t note_fp = (fixed_t)note->pos << FIXED_SHIFT;
-		fixed_t time = (scroll.start - stage.song_time) + (scroll.length * (note->pos - scroll.start_step) / scroll.length_step);
-		fixed_t y = note_y + FIXED_MUL(stage.speed, time * 150);
+		fixed_t y = Stage_GetNoteY(note_time->time);
+		fixed_t size = Stage_GetNoteY(note_time->end) - y + FIXED_UNIT; //Note height
+		
+		//Don't draw if below screen
+		if (y > (FIXED_DEC(SCREEN_HEIGHT,2) + size))
+			break;
 		
-		//Check if went above screen
-		if (y < FIXED_DEC(-16 - SCREEN_HEIGHT2, 1))
+		//Draw note
+		RECT note_src;
+		RECT_FIXED note_dst;
+		if (note->type & NOTE_FLAG_SUSTAIN)
 		{
-			//Wait for note to exit late time
-			if (note_fp + stage.late_safe >= stage.note_scroll)
-				continue;
-			
-			//Miss note if player's note
-			if (!(note->type & (bot | NOTE_FLAG_HIT | NOTE_FLAG_MINE)))
+			//Check for sustain clipping
+			fixed_t clip;
+			y -= size;
+			if ((note->type & (bot | NOTE_FLAG_HIT)) || ((this->pad_held & note_key[note->type & 0x3]) && (note_fp + stage.late_sus_safe >= stage.note_scroll)))
 			{
-				if (stage.mode < StageMode_Net1 || i == ((stage.mode == StageMode_Net1) ? 0 : 1))
-				{
-					//Missed note
-					Stage_CutVocal();
-					Stage_MissNote(this);
-					this->health -= 475;
-					
-					//Send miss packet
-					#ifdef PSXF_NETWORK
-						if (stage.mode >= StageMode_Net1)
-						{
-							//Send note hit packet
-							Packet note_hit;
-							note_hit[0] = PacketType_NoteMiss;
-							note_hit[1] = 0xFF;
-							
-							note_hit[2] = this->score >> 0;
-							note_hit[3] = this->score >> 8;
-							note_hit[4] = this->score >> 16;
-							note_hit[5] = this->score >> 24;
-							
-							Network_Send(&note_hit);
-						}
-					#endif
-				}
+				clip = FIXED_DEC(32 - SCREEN_HEIGHT2, 1) - y;
+				if (clip < 0)
+					clip = 0;
+			}
+			else
+			{
+				clip = 0;
 			}
 			
-			//Update current note
-			stage.cur_note++;
-		}
-		else
-		{
-			//Don't draw if below screen
-			RECT note_src;
-			RECT_FIXED note_dst;
-			if (y > (FIXED_DEC(SCREEN_HEIGHT,2) + scroll.size) || note->pos == 0xFFFF)
-				break;
-			
-			//Draw note
-			if (note->type & NOTE_FLAG_SUSTAIN)
+			//Draw sustain
+			if (note->type & NOTE_FLAG_SUSTAIN_END)
 			{
-				//Check for sustain clipping
-				fixed_t clip;
-				y -= scroll.size;
-				if ((note->type & (bot | NOTE_FLAG_HIT)) || ((this->pad_held & note_key[note->type & 0x3]) && (note_fp + stage.late_sus_safe >= stage.note_scroll)))
-				{
-					clip = FIXED_DEC(32 - SCREEN_HEIGHT2, 1) - y;
-					if (clip < 0)
-						clip = 0;
-				}
-				else
-				{
-					clip = 0;
-				}
-				
-				//Draw sustain
-				if (note->type & NOTE_FLAG_SUSTAIN_END)
-				{
-					if (clip < (24 << FIXED_SHIFT))
-					{
-						note_src.x = 160;
-						note_src.y = ((note->type & 0x3) << 5) + 4 + (clip >> FIXED_SHIFT);
-						note_src.w = 32;
-						note_src.h = 28 - (clip >> FIXED_SHIFT);
-						
-						note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
-						note_dst.y = y + clip;
-						note_dst.w = note_src.w << FIXED_SHIFT;
-						note_dst.h = (note_src.h << FIXED_SHIFT);
-						
-						if (stage.downscroll)
-						{
-							note_dst.y = -note_dst.y;
-							note_dst.h = -note_dst.h;
-						}
-						Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
-					}
-				}
-				else
+				if (clip < (24 << FIXED_SHIFT))
 				{
-					//Get note height
-					fixed_t next_time = (scroll.start - stage.song_time) + (scroll.length * (note->pos + 12 - scroll.start_step) / scroll.length_step);
-					fixed_t next_y = note_y + FIXED_MUL(stage.speed, next_time * 150) - scroll.size;
-					fixed_t next_size = next_y - y;
+					note_src.x = 160;
+					note_src.y = ((note->type & 0x3) << 5) + 4 + (clip >> FIXED_SHIFT);
+					note_src.w = 32;
+					note_src.h = 28 - (clip >> FIXED_SHIFT);
 					
-					if (clip < next_size)
+					note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
+					note_dst.y = y + clip;
+					note_dst.w = note_src.w << FIXED_SHIFT;
+					note_dst.h = (note_src.h << FIXED_SHIFT);
+					
+					if (stage.downscroll)
 					{
-						note_src.x = 160;
-						note_src.y = ((note->type & 0x3) << 5);
-						note_src.w = 32;
-						note_src.h = 16;
-						
-						note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
-						note_dst.y = y + clip;
-						note_dst.w = note_src.w << FIXED_SHIFT;
-						note_dst.h = (next_y - y) - clip;
-						
-						if (stage.downscroll)
-							note_dst.y = -note_dst.y - note_dst.h;
-						Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
+						note_dst.y = -note_dst.y;
+						note_dst.h = -note_dst.h;
 					}
+					Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
 				}
 			}
-			else if (note->type & NOTE_FLAG_MINE)
+			else
 			{
-				//Don't draw if already hit
-				if (note->type & NOTE_FLAG_HIT)
-					continue;
+				//Get note height
+				fixed_t next_y = Stage_GetNoteY(note_time->end) - size;
+				fixed_t next_size = next_y - y;
 				
-				//Draw note body
-				note_src.x = 192 + ((note->type & 0x1) << 5);
-				note_src.y = (note->type & 0x2) << 4;
-				note_src.w = 32;
-				note_src.h = 32;
-				
-				note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
-				note_dst.y = y - FIXED_DEC(16,1);
-				note_dst.w = note_src.w << FIXED_SHIFT;
-				note_dst.h = note_src.h << FIXED_SHIFT;
-				
-				if (stage.downscroll)
-					note_dst.y = -note_dst.y - note_dst.h;
-				Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
-				
-				if (stage.stage_id == StageId_Clwn_4)
+				if (clip < next_size)
 				{
-					//Draw note halo
 					note_src.x = 160;
-					note_src.y = 128 + ((animf_count & 0x3) << 3);
+					note_src.y = ((note->type & 0x3) << 5);
 					note_src.w = 32;
-					note_src.h = 8;
+					note_src.h = 16;
 					
-					note_dst.y -= FIXED_DEC(6,1);
-					note_dst.h >>= 2;
-					
-					Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
-				}
-				else
-				{
-					//Draw note fire
-					note_src.x = 192 + ((animf_count & 0x1) << 5);
-					note_src.y = 64 + ((animf_count & 0x2) * 24);
-					note_src.w = 32;
-					note_src.h = 48;
+					note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
+					note_dst.y = y + clip;
+					note_dst.w = note_src.w << FIXED_SHIFT;
+					note_dst.h = (next_y - y) - clip;
 					
 					if (stage.downscroll)
-					{
-						note_dst.y += note_dst.h;
-						note_dst.h = note_dst.h * -3 / 2;
-					}
-					else
-					{
-						note_dst.h = note_dst.h * 3 / 2;
-					}
+						note_dst.y = -note_dst.y - note_dst.h;
 					Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
 				}
 			}
-			else
+		}
+		else if (note->type & NOTE_FLAG_MINE)
+		{
+			//Don't draw if already hit
+			if (note->type & NOTE_FLAG_HIT)
+				continue;
+			
+			//Draw note body
+			note_src.x = 192 + ((note->type & 0x1) << 5);
+			note_src.y = (note->type & 0x2) << 4;
+			note_src.w = 32;
+			note_src.h = 32;
+			
+			note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
+			note_dst.y = y - FIXED_DEC(16,1);
+			note_dst.w = note_src.w << FIXED_SHIFT;
+			note_dst.h = note_src.h << FIXED_SHIFT;
+			
+			if (stage.downscroll)
+				note_dst.y = -note_dst.y - note_dst.h;
+			Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
+			
+			if (stage.stage_id == StageId_Clwn_4)
 			{
-				//Don't draw if already hit
-				if (note->type & NOTE_FLAG_HIT)
-					continue;
-				
-				//Draw note
-				note_src.x = 32 + ((note->type & 0x3) << 5);
-				note_src.y = 0;
+				//Draw note halo
+				note_src.x = 160;
+				note_src.y = 128 + ((animf_count & 0x3) << 3);
 				note_src.w = 32;
-				note_src.h = 32;
+				note_src.h = 8;
 				
-				note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
-				note_dst.y = y - FIXED_DEC(16,1);
-				note_dst.w = note_src.w << FIXED_SHIFT;
-				note_dst.h = note_src.h << FIXED_SHIFT;
+				note_dst.y -= FIXED_DEC(6,1);
+				note_dst.h >>= 2;
+				
+				Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
+			}
+			else
+			{
+				//Draw note fire
+				note_src.x = 192 + ((animf_count & 0x1) << 5);
+				note_src.y = 64 + ((animf_count & 0x2) * 24);
+				note_src.w = 32;
+				note_src.h = 48;
 				
 				if (stage.downscroll)
-					note_dst.y = -note_dst.y - note_dst.h;
+				{
+					note_dst.y += note_dst.h;
+					note_dst.h = note_dst.h * -3 / 2;
+				}
+				else
+				{
+					note_dst.h = note_dst.h * 3 / 2;
+				}
 				Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
 			}
 		}
+		else
+		{
+			//Don't draw if already hit
+			if (note->type & NOTE_FLAG_HIT)
+				continue;
+			
+			//Draw note
+			note_src.x = 32 + ((note->type & 0x3) << 5);
+			note_src.y = 0;
+			note_src.w = 32;
+			note_src.h = 32;
+			
+			note_dst.x = note_x[(note->type & 0x7) ^ stage.note_swap] - FIXED_DEC(16,1);
+			note_dst.y = y - FIXED_DEC(16,1);
+			note_dst.w = note_src.w << FIXED_SHIFT;
+			note_dst.h = note_src.h << FIXED_SHIFT;
+			
+			if (stage.downscroll)
+				note_dst.y = -note_dst.y - note_dst.h;
+			Stage_DrawTex(&stage.tex_hud0, &note_src, &note_dst, stage.bump);
+		}
 	}
 }
 
@@ -1049,14 +1113,22 @@ static void Stage_LoadPlayer(void)
 {
 	//Load player character
 	Character_Free(stage.player);
+	int tag = Mem_SetTag(MemTag_Character);
+	Stage_PlanBegin((StagePlanFunc)stage.stage_def->pchar.new);
 	stage.player = stage.stage_def->pchar.new(stage.stage_def->pchar.x, stage.stage_def->pchar.y);
+	Stage_PlanEnd();
+	Mem_SetTag(tag);
 }
 
 static void Stage_LoadOpponent(void)
 {
 	//Load opponent character
 	Character_Free(stage.opponent);
+	int tag = Mem_SetTag(MemTag_Character);
+	Stage_PlanBegin((StagePlanFunc)stage.stage_def->ochar.new);
 	stage.opponent = stage.stage_def->ochar.new(stage.stage_def->ochar.x, stage.stage_def->ochar.y);
+	Stage_PlanEnd();
+	Mem_SetTag(tag);
 }
 
 static void Stage_LoadGirlfriend(void)
@@ -1064,7 +1136,13 @@ static void Stage_LoadGirlfriend(void)
 	//Load girlfriend character
 	Character_Free(stage.gf);
 	if (stage.stage_def->gchar.new != NULL)
+	{
+		int tag = Mem_SetTag(MemTag_Character);
+		Stage_PlanBegin((StagePlanFunc)stage.stage_def->gchar.new);
 		stage.gf = stage.stage_def->gchar.new(stage.stage_def->gchar.x, stage.stage_def->gchar.y);
+		Stage_PlanEnd();
+		Mem_SetTag(tag);
+	}
 	else
 		stage.gf = NULL;
 }
@@ -1074,14 +1152,16 @@ static void Stage_LoadStage(void)
 	//Load back
 	if (stage.back != NULL)
 		stage.back->free(stage.back);
+	int tag = Mem_SetTag(MemTag_Gfx);
+	Stage_PlanBegin((StagePlanFunc)stage.stage_def->back);
 	stage.back = stage.stage_def->back();
+	Stage_PlanEnd();
+	Mem_SetTag(tag);
 }
 
-static void Stage_LoadChart(void)
+static void Stage_GetChartPath(char *chart_path, const StageDef *stage_def, StageDiff difficulty)
 {
-	//Load stage data
-	char chart_path[64];
-	if (stage.stage_def->week & 0x80)
+	if (stage_def->week & 0x80)
 	{
 		//Use mod path convention
 		static const char *mod_format[] = {
@@ -1089,79 +1169,113 @@ static void Stage_LoadChart(void)
 			"\\CLWN\\CLWN.%d%c.CHT;1" //Tricky
 		};
 		
-		sprintf(chart_path, mod_format[stage.stage_def->week & 0x7F], stage.stage_def->week_song, "ENH"[stage.stage_diff]);
+		sprintf(chart_path, mod_format[stage_def->week & 0x7F], stage_def->week_song, "ENH"[difficulty]);
 	}
 	else
 	{
 		//Use standard path convention
-		sprintf(chart_path, "\\WEEK%d\\%d.%d%c.CHT;1", stage.stage_def->week, stage.stage_def->week, stage.stage_def->week_song, "ENH"[stage.stage_diff]);
+		sprintf(chart_path, "\\WEEK%d\\%d.%d%c.CHT;1", stage_def->week, stage_def->week, stage_def->week_song, "ENH"[difficulty]);
+	}
+}
+
+static const char *Stage_GetHUD0Path(StageId id)
+{
+	if (id >= StageId_6_1 && id <= StageId_6_3)
+		return "\\STAGE\\HUD0WEEB.TIM;1";
+	return "\\STAGE\\HUD0.TIM;1";
+}
+
+static void Stage_LoadLanes(void)
+{
+	//Count notes in each lane
+	for (int i = 0; i <= NOTE_LANES; i++)
+		stage.lane_start[i] = 0;
+	for (Note *note = stage.notes; note->pos != 0xFFFF; note++)
+		stage.lane_start[(note->type & NOTE_LANE_MASK) + 1]++;
+	for (int i = 0; i < NOTE_LANES; i++)
+		stage.lane_start[i + 1] += stage.lane_start[i];
+	
+	//Group note indices by lane, keeping chart order within each one
+	int tag = Mem_SetTag(MemTag_Chart);
+	stage.lane_notes = (u16*)Mem_Alloc((stage.num_notes + 1) * sizeof(u16));
+	Mem_SetTag(tag);
+	if (stage.lane_notes == NULL)
+	{
+		sprintf(error_msg, "[Stage_LoadLanes] Failed to allocate lanes for %d notes", (int)stage.num_notes);
+		ErrorLock();
+		return;
 	}
 	
-	if (stage.chart_data != NULL)
-		Mem_Free(stage.chart_data);
-	stage.chart_data = IO_Read(chart_path);
-	u8 *chart_byte = (u8*)stage.chart_data;
+	for (int i = 0; i < NOTE_LANES; i++)
+		stage.lane_cur[i] = stage.lane_start[i];
+	for (Note *note = stage.notes; note->pos != 0xFFFF; note++)
+		stage.lane_notes[stage.lane_cur[note->type & NOTE_LANE_MASK]++] = note - stage.notes;
+	for (int i = 0; i < NOTE_LANES; i++)
+		stage.lane_cur[i] = stage.lane_start[i];
+}
+
+static void Stage_LoadTimes(void)
+{
+	//Allocate times
+	int tag = Mem_SetTag(MemTag_Chart);
+	stage.note_times = (NoteTime*)Mem_Alloc((stage.num_notes + 1) * sizeof(NoteTime));
+	Mem_SetTag(tag);
+	if (stage.note_times == NULL)
+	{
+		sprintf(error_msg, "[Stage_LoadTimes] Failed to allocate times for %d notes", (int)stage.num_notes);
+		ErrorLock();
+		return;
+	}
 	
-	#ifdef PSXF_PC
-		//Get lengths
-		u16 note_off = chart_byte[0] | (chart_byte[1] << 8);
-		
-		u8 *section_p = chart_byte + 2;
-		u8 *note_p = chart_byte + note_off;
-		
-		u8 *section_pp;
-		u8 *note_pp;
-		
-		size_t sections = (note_off - 2) >> 2;
-		size_t notes = 0;
-		
-		for (note_pp = note_p;; note_pp += 4)
-		{
-			notes++;
-			u16 pos = note_pp[0] | (note_pp[1] << 8);
-			if (pos == 0xFFFF)
-				break;
-		}
-		
-		if (notes)
-			stage.num_notes = notes - 1;
-		else
-			stage.num_notes = 0;
-		
-		//Realloc for separate structs
-		size_t sections_size = sections * sizeof(Section);
-		size_t notes_size = notes * sizeof(Note);
-		size_t notes_off = MEM_ALIGN(sections_size);
-		
-		u8 *nchart = Mem_Alloc(notes_off + notes_size);
-		
-		Section *nsection_p = stage.sections = (Section*)nchart;
-		section_pp = section_p;
-		for (size_t i = 0; i < sections; i++, section_pp += 4, nsection_p++)
-		{
-			nsection_p->end = section_pp[0] | (section_pp[1] << 8);
-			nsection_p->flag = section_pp[2] | (section_pp[3] << 8);
-		}
-		
-		Note *nnote_p = stage.notes = (Note*)(nchart + notes_off);
-		note_pp = note_p;
-		for (size_t i = 0; i < notes; i++, note_pp += 4, nnote_p++)
+	//Time every note the way Stage_ChangeBPM moves the timing base at each section
+	Section *section = stage.sections;
+	fixed_t time_base = 0;
+	u16 step_base = 0;
+	fixed_t step_crochet = Stage_GetCrochet(section->flag & SECTION_FLAG_BPM_MASK);
+	
+	NoteTime *note_time = stage.note_times;
+	for (Note *note = stage.notes; note->pos != 0xFFFF; note++, note_time++)
+	{
+		while (note->pos >= section->end)
 		{
-			nnote_p->pos = note_pp[0] | (note_pp[1] << 8);
-			nnote_p->type = note_pp[2] | (note_pp[3] << 8);
+			time_base += FIXED_DIV(((fixed_t)section->end - step_base) << FIXED_SHIFT, step_crochet);
+			step_base = section->end;
+			section++;
+			step_crochet = Stage_GetCrochet(section->flag & SECTION_FLAG_BPM_MASK);
 		}
-		
-		//Use reformatted chart
+		note_time->time = time_base + FIXED_DIV(((fixed_t)note->pos - step_base) << FIXED_SHIFT, step_crochet);
+		note_time->end = time_base + FIXED_DIV(((fixed_t)note->pos + 12 - step_base) << FIXED_SHIFT, step_crochet);
+	}
+}
+
+static void Stage_LoadChart(void)
+{
+	//Load stage data
+	char chart_path[64];
+	Stage_GetChartPath(chart_path, stage.stage_def, stage.stage_diff);
+	
+	if (stage.chart_data != NULL)
 		Mem_Free(stage.chart_data);
-		stage.chart_data = (IO_Data)nchart;
-	#else
-		//Directly use section and notes pointers
-		stage.sections = (Section*)(chart_byte + 2);
-		stage.notes = (Note*)(chart_byte + *((u16*)stage.chart_data));
-		
-		for (Note *note = stage.notes; note->pos != 0xFFFF; note++)
-			stage.num_notes++;
-	#endif
+	if (stage.lane_notes != NULL)
+		Mem_Free(stage.lane_notes);
+	if (stage.note_times != NULL)
+		Mem_Free(stage.note_times);
+	int tag = Mem_SetTag(MemTag_Chart);
+	stage.chart_data = IO_Read(chart_path);
+	Mem_SetTag(tag);
+	
+	//Use sections and notes where they were read, the chart is laid out for both backends
+	ChartHeader *chart = (ChartHeader*)stage.chart_data;
+	if (chart->magic[0] != 'F' || chart->magic[1] != 'C' || chart->magic[2] != 'H' || chart->magic[3] != 'T' || chart->version != CHART_VERSION)
+	{
+		sprintf(error_msg, "[Stage_LoadChart] %s isn't a version %d chart", chart_path, CHART_VERSION);
+		ErrorLock();
+		return;
+	}
+	
+	stage.sections = (Section*)((u8*)stage.chart_data + chart->section_pos);
+	stage.notes = (Note*)((u8*)stage.chart_data + chart->note_pos);
+	stage.num_notes = chart->notes;
 	
 	//Swap chart
 	if (stage.mode == StageMode_Swap)
@@ -1176,18 +1290,13 @@ static void Stage_LoadChart(void)
 		}
 	}
 	
-	//Count max scores
-	stage.player_state[0].max_score = 0;
-	stage.player_state[1].max_score = 0;
-	for (Note *note = stage.notes; note->pos != 0xFFFF; note++)
-	{
-		if (note->type & (NOTE_FLAG_SUSTAIN | NOTE_FLAG_MINE))
-			continue;
-		if (note->type & NOTE_FLAG_OPPONENT)
-			stage.player_state[1].max_score += 35;
-		else
-			stage.player_state[0].max_score += 35;
-	}
+	Stage_LoadLanes();
+	Stage_LoadTimes();
+	
+	//Use max scores counted by funkinchartpak
+	int swap = (stage.mode == StageMode_Swap) ? 1 : 0;
+	stage.player_state[0].max_score = chart->max_score[swap];
+	stage.player_state[1].max_score = chart->max_score[swap ^ 1];
 	if (stage.mode >= StageMode_2P && stage.player_state[1].max_score > stage.player_state[0].max_score)
 		stage.max_score = stage.player_state[1].max_score;
 	else
@@ -1201,7 +1310,6 @@ static void Stage_LoadChart(void)
 	stage.step_crochet = 0;
 	stage.time_base = 0;
 	stage.step_base = 0;
-	stage.section_base = stage.cur_section;
 	Stage_ChangeBPM(stage.cur_section->flag & SECTION_FLAG_BPM_MASK, 0);
 }
 
@@ -1215,6 +1323,7 @@ static void Stage_LoadMusic(void)
 	
 	//Find music file and begin seeking to it
 	Audio_SeekXA_Track(stage.stage_def->music_track);
+	Audio_SetRateXA(stage.rate);
 	
 	//Initialize music state
 	stage.note_scroll = FIXED_DEC(-5 * 4 * 12,1);
@@ -1230,6 +1339,48 @@ static void Stage_LoadMusic(void)
 		stage.gf->sing_end += stage.note_scroll;
 }
 
+static void Stage_LoadPools(void)
+{
+	//Find the most hittable notes inside any window the size of an object's lifetime,
+	//using song times so tempo changes and the practice rate are counted
+	u16 peak = 0;
+	size_t tail = 0;
+	u16 in_window = 0;
+	for (size_t i = 0; i < stage.num_notes; i++)
+	{
+		if (stage.notes[i].type & (NOTE_FLAG_SUSTAIN | NOTE_FLAG_MINE))
+			continue;
+		in_window++;
+		for (; stage.note_times[tail].time + STAGE_POOL_WINDOW <= stage.note_times[i].time; tail++)
+			if (!(stage.notes[tail].type & (NOTE_FLAG_SUSTAIN | NOTE_FLAG_MINE)))
+				in_window--;
+		if (in_window > peak)
+			peak = in_window;
+	}
+	
+	//Every hit makes a combo and SICKs make 3 splashes, misses can add a combo each
+	size_t combos = peak + STAGE_POOL_SLACK * ((stage.mode >= StageMode_2P) ? 2 : 1);
+	size_t splashes = peak * 3;
+	if (combos < STAGE_POOL_MIN)
+		combos = STAGE_POOL_MIN;
+	if (splashes < STAGE_POOL_MIN * 3)
+		splashes = STAGE_POOL_MIN * 3;
+	
+	//Only reallocate if the loaded chart needs more than we have, objects are freed by now
+	int tag = Mem_SetTag(MemTag_Object);
+	if (stage.pool_combo.count < combos)
+	{
+		ObjectPool_Quit(&stage.pool_combo);
+		ObjectPool_Init(&stage.pool_combo, "Combo", sizeof(Obj_Combo), combos);
+	}
+	if (stage.pool_splash.count < splashes)
+	{
+		ObjectPool_Quit(&stage.pool_splash);
+		ObjectPool_Init(&stage.pool_splash, "Splash", sizeof(Obj_Splash), splashes);
+	}
+	Mem_SetTag(tag);
+}
+
 static void Stage_LoadState(void)
 {
 	//Initialize stage state
@@ -1275,6 +1426,8 @@ static void Stage_LoadState(void)
 	ObjectList_Free(&stage.objlist_splash);
 	ObjectList_Free(&stage.objlist_fg);
 	ObjectList_Free(&stage.objlist_bg);
+	
+	Stage_LoadPools();
 }
 
 //prepare health in event of no set health color
@@ -1293,19 +1446,67 @@ static void Stage_HealthPrep(void)
 }
 
 //Stage functions
+void Stage_Prefetch(StageId id, StageDiff difficulty)
+{
+	#ifdef STAGE_PLAN
+		const StageDef *stage_def = &stage_defs[id];
+		
+		//Read HUD and chart ahead
+		CdlFILE file;
+		IO_FindFile(&file, Stage_GetHUD0Path(id));
+		IO_Prefetch(&file);
+		IO_FindFile(&file, "\\STAGE\\HUD1.TIM;1");
+		IO_Prefetch(&file);
+		
+		char chart_path[64];
+		Stage_GetChartPath(chart_path, stage_def, difficulty);
+		IO_FindFile(&file, chart_path);
+		IO_Prefetch(&file);
+		
+		//Read background and characters ahead from their last loads
+		Stage_PlanPrefetch((StagePlanFunc)stage_def->back);
+		Stage_PlanPrefetch((StagePlanFunc)stage_def->pchar.new);
+		Stage_PlanPrefetch((StagePlanFunc)stage_def->ochar.new);
+		if (stage_def->gchar.new != NULL)
+			Stage_PlanPrefetch((StagePlanFunc)stage_def->gchar.new);
+		
+		//Start preparing music
+		Audio_PrefetchXA_Track(stage_def->music_track);
+	#else
+		(void)id;
+		(void)difficulty;
+	#endif
+}
+
 void Stage_Load(StageId id, StageDiff difficulty, boolean story)
 {
+	#ifdef PSXF_PC
+		IO_StatsBegin("Stage_Load");
+	#endif
+	
+	//Everything allocated from here until Stage_Unload lives in the stage's scope
+	MemStat_Begin();
+	Mem_PushScope();
+	
 	//Get stage definition
 	stage.stage_def = &stage_defs[stage.stage_id = id];
 	stage.stage_diff = difficulty;
 	stage.story = story;
+	stage.rate = stage_rates[stage.rate_mode];
+	
+	//Start reading everything the stage needs, the loads below pick it up as it arrives
+	Stage_Prefetch(id, difficulty);
 	
 	//Load HUD textures
-	if (id >= StageId_6_1 && id <= StageId_6_3)
-		Gfx_LoadTex(&stage.tex_hud0, IO_Read("\\STAGE\\HUD0WEEB.TIM;1"), GFX_LOADTEX_FREE);
-	else
-		Gfx_LoadTex(&stage.tex_hud0, IO_Read("\\STAGE\\HUD0.TIM;1"), GFX_LOADTEX_FREE);
-	Gfx_LoadTex(&stage.tex_hud1, IO_Read("\\STAGE\\HUD1.TIM;1"), GFX_LOADTEX_FREE);
+	IO_Data hud[2];
+	int tag = Mem_SetTag(MemTag_Gfx);
+	IO_ReadBatch((const char *[]){
+		Stage_GetHUD0Path(id),
+		"\\STAGE\\HUD1.TIM;1",
+	}, hud, 2);
+	Mem_SetTag(tag);
+	Gfx_LoadTex(&stage.tex_hud0, hud[0], GFX_LOADTEX_FREE);
+	Gfx_LoadTex(&stage.tex_hud1, hud[1], GFX_LOADTEX_FREE);
 	
 	//Load stage background
 	Stage_LoadStage();
@@ -1343,8 +1544,17 @@ void Stage_Load(StageId id, StageDiff difficulty, boolean story)
 	stage.note_scroll = 0;
 	Stage_LoadMusic();
 	
-	//Test offset
-	stage.offset = 0;
+	//Get calibrated offset
+	stage.offset = Audio_GetLatency();
+	
+	#ifdef STAGE_PLAN
+		//Drop anything planned that wasn't read this time
+		IO_PrefetchClear();
+	#endif
+	
+	#ifdef PSXF_PC
+		IO_StatsEnd();
+	#endif
 	
 	#ifdef PSXF_NETWORK
 	if (stage.mode >= StageMode_Net1 && Network_IsHost())
@@ -1362,31 +1572,31 @@ void Stage_Load(StageId id, StageDiff difficulty, boolean story)
 
 void Stage_Unload(void)
 {
+	//Let pending reads land before their buffers are freed
+	IO_Wait();
+	
 	//Disable net mode to not break the game
 	if (stage.mode >= StageMode_Net1)
 		stage.mode = StageMode_Normal;
 	
-	//Unload stage background
-	if (stage.back != NULL)
-		stage.back->free(stage.back);
+	//Everything the stage loaded lives in its scope, so it's all released by the pop below
+	//Backgrounds, characters and objects only hold memory, just forget them
 	stage.back = NULL;
-	
-	//Unload stage data
-	Mem_Free(stage.chart_data);
 	stage.chart_data = NULL;
-	
-	//Free objects
-	ObjectList_Free(&stage.objlist_splash);
-	ObjectList_Free(&stage.objlist_fg);
-	ObjectList_Free(&stage.objlist_bg);
-	
-	//Free characters
-	Character_Free(stage.player);
+	stage.lane_notes = NULL;
+	stage.note_times = NULL;
+	stage.objlist_splash = stage.objlist_fg = stage.objlist_bg = NULL;
+	stage.pool_splash.data = stage.pool_combo.data = NULL;
+	stage.pool_splash.free_list = stage.pool_combo.free_list = NULL;
+	stage.pool_splash.count = stage.pool_combo.count = 0;
 	stage.player = NULL;
-	Character_Free(stage.opponent);
 	stage.opponent = NULL;
-	Character_Free(stage.gf);
 	stage.gf = NULL;
+	
+	//Release the stage's scope, anything still held after it was never freed
+	Mem_PopScope();
+	MemStat_Leaks("Stage");
+	MemStat_End("Stage");
 }
 
 static boolean Stage_NextLoad(void)
@@ -1458,8 +1668,6 @@ static boolean Stage_NextLoad(void)
 //load dialogue related files
 void Stage_LoadDia(void)
 {
-	Stage *this = (Stage*)Mem_Alloc(sizeof(Stage));
-
 	FontData_Load(&stage.font_arial, Font_Arial);
 }
 
@@ -1530,6 +1738,7 @@ void Stage_Tick(void)
 				//Load next song
 				Stage_Unload();
 				
+				Stage_Prefetch(stage.stage_def->next_stage, stage.stage_diff);
 				LoadScr_Start();
 				Stage_Load(stage.stage_def->next_stage, stage.stage_diff, stage.story);
 				LoadScr_End();
@@ -1538,6 +1747,7 @@ void Stage_Tick(void)
 				//Reload song
 				Stage_Unload();
 				
+				Stage_Prefetch(stage.stage_id, stage.stage_diff);
 				LoadScr_Start();
 				Stage_Load(stage.stage_id, stage.stage_diff, stage.story);
 				LoadScr_End();
@@ -1622,6 +1832,10 @@ void Stage_Tick(void)
 					fixed_t audio_time_pof = (fixed_t)Audio_TellXA_Milli();
 					fixed_t audio_time = (audio_time_pof > 0) ? (audio_time_pof - stage.offset) : 0;
 					
+					//Prepare next song's music in the background
+					if (stage.story && stage.stage_def->next_stage != stage.stage_id && audio_time >= STAGE_PREFETCH_MS)
+						Audio_PrefetchXA_Track(stage_defs[stage.stage_def->next_stage].music_track);
+					
 					if (stage.expsync)
 					{
 						//Get playing song position
@@ -1715,7 +1929,6 @@ void Stage_Tick(void)
 					//Update BPM
 					u16 next_bpm = stage.cur_section->flag & SECTION_FLAG_BPM_MASK;
 					Stage_ChangeBPM(next_bpm, end);
-					stage.section_base = stage.cur_section;
 					
 					//Recalculate scroll based off new BPM
 					next_scroll = ((fixed_t)stage.step_base << FIXED_SHIFT) + FIXED_MUL(stage.song_time - stage.time_base, stage.step_crochet);
@@ -1974,6 +2187,10 @@ void Stage_Tick(void)
 			//Unload stage data
 			Mem_Free(stage.chart_data);
 			stage.chart_data = NULL;
+			Mem_Free(stage.lane_notes);
+			stage.lane_notes = NULL;
+			Mem_Free(stage.note_times);
+			stage.note_times = NULL;
 			
 			//Free background
 			stage.back->free(stage.back);
@@ -102,6 +102,17 @@ typedef enum
 	StageMode_Net2,
 } StageMode;
 
+typedef enum
+{
+	StageRate_Normal, //1x
+	StageRate_Fast,   //1.5x
+	StageRate_Double, //2x
+	StageRate_Half,   //0.5x
+	StageRate_Slow,   //0.75x
+	
+	StageRate_Max,
+} StageRate;
+
 typedef enum
 {
 	StageTrans_Menu,
@@ -160,12 +171,32 @@ typedef struct
 #define NOTE_FLAG_MINE        (1 << 6) //Note is a mine
 #define NOTE_FLAG_HIT         (1 << 7) //Note has been hit
 
+#define NOTE_LANE_MASK (NOTE_FLAG_SUSTAIN | NOTE_FLAG_OPPONENT | 0x3) //Sustains, taps and mines of each player's arrows
+#define NOTE_LANES     16
+
 typedef struct
 {
 	u16 pos; //1/12 steps
 	u16 type;
 } Note;
 
+typedef struct
+{
+	fixed_t time; //Song time the note is hit at
+	fixed_t end; //Song time a step later, where a sustain piece ends
+} NoteTime;
+
+#define CHART_VERSION 2
+
+typedef struct
+{
+	char magic[4]; //"FCHT"
+	u32 version;
+	u32 sections, notes; //Not counting the 0xFFFF terminators each table ends with
+	u32 section_pos, note_pos;
+	s32 max_score[2]; //Player and opponent
+} ChartHeader;
+
 typedef struct
 {
 	Character *character;
@@ -187,8 +218,9 @@ typedef struct
 	//Stage settings
 	boolean ghost, downscroll, expsync;
 	s32 mode;
+	s32 rate_mode; //Practice playback rate
 	
-	u32 offset;
+	s32 offset; //Audio latency in milliseconds
 	
 	//HUD textures
 	Gfx_Tex tex_hud0, tex_hud1;
@@ -201,9 +233,14 @@ typedef struct
 	IO_Data chart_data;
 	Section *sections;
 	Note *notes;
+	NoteTime *note_times; //Parallel to notes
 	size_t num_notes;
 	
-	fixed_t speed;
+	u16 *lane_notes; //Note indices grouped by lane, in chart order
+	u16 lane_start[NOTE_LANES + 1];
+	u16 lane_cur[NOTE_LANES]; //First note of each lane that could still be hit
+	
+	fixed_t speed, rate;
 	fixed_t step_crochet, step_time;
 	fixed_t early_safe, late_safe, early_sus_safe, late_sus_safe;
 	
@@ -235,7 +272,6 @@ typedef struct
 	
 	fixed_t time_base;
 	u16 step_base;
-	Section *section_base;
 	
 	s16 song_step;
 	
@@ -263,6 +299,9 @@ typedef struct
 	
 	//Object lists
 	ObjectList objlist_splash, objlist_fg, objlist_bg;
+	
+	//Object pools, sized for the chart by Stage_LoadState
+	ObjectPool pool_splash, pool_combo;
 } Stage;
 
 extern Stage stage;
@@ -274,6 +313,7 @@ void Stage_DrawTexArb(Gfx_Tex *tex, const RECT *src, const POINT_FIXED *p0, cons
 void Stage_BlendTexArb(Gfx_Tex *tex, const RECT *src, const POINT_FIXED *p0, const POINT_FIXED *p1, const POINT_FIXED *p2, const POINT_FIXED *p3, fixed_t zoom, u8 mode);
 
 //Stage functions
+void Stage_Prefetch(StageId id, StageDiff difficulty);
 void Stage_Load(StageId id, StageDiff difficulty, boolean story);
 void Stage_Unload();
 void Stage_Tick();
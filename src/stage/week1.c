@@ -133,8 +133,8 @@ StageBack *Back_Week1_New(void)
 	
 	//Load background textures
 	IO_Data arc_back = IO_Read("\\WEEK1\\BACK.ARC;1");
-	Gfx_LoadTex(&this->tex_back0, Archive_Find(arc_back, "back0.tim"), 0);
-	Gfx_LoadTex(&this->tex_back1, Archive_Find(arc_back, "back1.tim"), 0);
+	Gfx_LoadTex(&this->tex_back0, Archive_FindConst(arc_back, "back0.tim"), 0);
+	Gfx_LoadTex(&this->tex_back1, Archive_FindConst(arc_back, "back1.tim"), 0);
 	Mem_Free(arc_back);
 	
 	return (StageBack*)this;
@@ -234,16 +234,16 @@ StageBack *Back_Week4_New(void)
 	
 	//Load background textures
 	IO_Data arc_back = IO_Read("\\WEEK4\\BACK.ARC;1");
-	Gfx_LoadTex(&this->tex_back0, Archive_Find(arc_back, "back0.tim"), 0);
-	Gfx_LoadTex(&this->tex_back1, Archive_Find(arc_back, "back1.tim"), 0);
-	Gfx_LoadTex(&this->tex_back2, Archive_Find(arc_back, "back2.tim"), 0);
-	Gfx_LoadTex(&this->tex_back3, Archive_Find(arc_back, "back3.tim"), 0);
+	Gfx_LoadTex(&this->tex_back0, Archive_FindConst(arc_back, "back0.tim"), 0);
+	Gfx_LoadTex(&this->tex_back1, Archive_FindConst(arc_back, "back1.tim"), 0);
+	Gfx_LoadTex(&this->tex_back2, Archive_FindConst(arc_back, "back2.tim"), 0);
+	Gfx_LoadTex(&this->tex_back3, Archive_FindConst(arc_back, "back3.tim"), 0);
 	Mem_Free(arc_back);
 	
 	//Load henchmen textures
 	this->arc_hench = IO_Read("\\WEEK4\\HENCH.ARC;1");
-	this->arc_hench_ptr[0] = Archive_Find(this->arc_hench, "hench0.tim");
-	this->arc_hench_ptr[1] = Archive_Find(this->arc_hench, "hench1.tim");
+	this->arc_hench_ptr[0] = Archive_FindConst(this->arc_hench, "hench0.tim");
+	this->arc_hench_ptr[1] = Archive_FindConst(this->arc_hench, "hench1.tim");
 	
 	//Initialize car state
 	this->car_x = CAR_END_X;
@@ -209,12 +209,12 @@ StageBack *Back_Week5_New()
 	
 	//Load background textures
 	IO_Data arc_back = IO_Read("\\WEEK5\\BACK.ARC;1");
-	Gfx_LoadTex(&this->tex_back0, Archive_Find(arc_back, "back0.tim"), 0);
-	Gfx_LoadTex(&this->tex_back1, Archive_Find(arc_back, "back1.tim"), 0);
-	Gfx_LoadTex(&this->tex_back2, Archive_Find(arc_back, "back2.tim"), 0);
-	Gfx_LoadTex(&this->tex_back3, Archive_Find(arc_back, "back3.tim"), 0);
-	Gfx_LoadTex(&this->tex_back4, Archive_Find(arc_back, "back4.tim"), 0);
-	Gfx_LoadTex(&this->tex_back5, Archive_Find(arc_back, "back5.tim"), 0);
+	Gfx_LoadTex(&this->tex_back0, Archive_FindConst(arc_back, "back0.tim"), 0);
+	Gfx_LoadTex(&this->tex_back1, Archive_FindConst(arc_back, "back1.tim"), 0);
+	Gfx_LoadTex(&this->tex_back2, Archive_FindConst(arc_back, "back2.tim"), 0);
+	Gfx_LoadTex(&this->tex_back3, Archive_FindConst(arc_back, "back3.tim"), 0);
+	Gfx_LoadTex(&this->tex_back4, Archive_FindConst(arc_back, "back4.tim"), 0);
+	Gfx_LoadTex(&this->tex_back5, Archive_FindConst(arc_back, "back5.tim"), 0);
 	Mem_Free(arc_back);
 	
 	return (StageBack*)this;
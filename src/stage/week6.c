@@ -304,9 +304,9 @@ StageBack *Back_Week6_New(void)
 		
 		//Load background textures
 		IO_Data arc_back = IO_Read("\\WEEK6\\BACK.ARC;1");
-		Gfx_LoadTex(&this->tex_back0, Archive_Find(arc_back, "back0.tim"), 0);
-		Gfx_LoadTex(&this->tex_back1, Archive_Find(arc_back, "back1.tim"), 0);
-		Gfx_LoadTex(&this->tex_back2, Archive_Find(arc_back, "back2.tim"), 0);
+		Gfx_LoadTex(&this->tex_back0, Archive_FindConst(arc_back, "back0.tim"), 0);
+		Gfx_LoadTex(&this->tex_back1, Archive_FindConst(arc_back, "back1.tim"), 0);
+		Gfx_LoadTex(&this->tex_back2, Archive_FindConst(arc_back, "back2.tim"), 0);
 		Mem_Free(arc_back);
 		
 		//Initialize freaks state
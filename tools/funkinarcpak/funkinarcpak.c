@@ -23,15 +23,152 @@ void Write32(FILE *fp, uint32_t x)
 	fputc(x >> 24, fp);
 }
 
+//LZ4 block compression
+#define LZ4_HASH_BITS 16
+#define LZ4_MFLIMIT   12 //Last match has to start this far from the end
+#define LZ4_LASTLITS  5  //And end this far from it
+
+#define ARC_METHOD_STORE 0
+#define ARC_METHOD_LZ4   1
+
+//Version 2 archives, a header and entries with sizes and flags, files on sector boundaries
+#define ARC_V2_MAGIC     "FARC"
+#define ARC_V2_VERSION   2
+#define ARC_V2_HEAD_SIZE 32
+#define ARC_V2_ENT_SIZE  32
+#define ARC_SECT_SIZE    2048
+
+#define ARC_FLAG_SECTOR (1 << 0) //Entry starts on a sector, so it can be read on its own
+
+//Hash index
+#define ARC_INDEX_MAGIC "\0MPH"
+#define ARC_DISP_MAX    0xFFFF
+
+uint32_t Hash(const char *name)
+{
+	//FNV-1a of the name padded to 12 bytes, must match Archive_Hash
+	uint32_t hash = 0x811C9DC5;
+	for (int i = 0; i < 12; i++)
+		hash = (hash ^ (uint8_t)name[i]) * 0x01000193;
+	return hash;
+}
+
+uint32_t Slot(uint32_t hash, uint16_t disp, uint32_t files)
+{
+	//Mix displacement into the hash, must match Archive_Slot
+	hash ^= disp * 0x9E3779B9;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6B;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35;
+	hash ^= hash >> 16;
+	return hash % files;
+}
+
+uint32_t Read32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint8_t *LZ4_WriteLength(uint8_t *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+size_t LZ4_Compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+	static uint32_t table[1 << LZ4_HASH_BITS];
+	memset(table, 0xFF, sizeof(table));
+	
+	uint8_t *op = dst;
+	size_t ip = 0, anchor = 0;
+	
+	if (size > LZ4_MFLIMIT)
+	{
+		while (ip < size - LZ4_MFLIMIT)
+		{
+			//Look up last position with the same 4 bytes
+			uint32_t seq = Read32(src + ip);
+			uint32_t hash = (seq * 2654435761U) >> (32 - LZ4_HASH_BITS);
+			uint32_t ref = table[hash];
+			table[hash] = ip;
+			
+			if (ref == 0xFFFFFFFF || ip - ref > 0xFFFF || Read32(src + ref) != seq)
+			{
+				ip++;
+				continue;
+			}
+			
+			//Extend match
+			size_t len = 4;
+			while (ip + len < size - LZ4_LASTLITS && src[ref + len] == src[ip + len])
+				len++;
+			
+			//Write literals and match
+			size_t lits = ip - anchor;
+			uint8_t *token = op++;
+			*token = ((lits >= 15) ? 15 : lits) << 4;
+			if (lits >= 15)
+				op = LZ4_WriteLength(op, lits - 15);
+			memcpy(op, src + anchor, lits);
+			op += lits;
+			
+			*op++ = (ip - ref);
+			*op++ = (ip - ref) >> 8;
+			
+			*token |= (len - 4 >= 15) ? 15 : (len - 4);
+			if (len - 4 >= 15)
+				op = LZ4_WriteLength(op, len - 4 - 15);
+			
+			ip += len;
+			anchor = ip;
+		}
+	}
+	
+	//Write last literals
+	size_t lits = size - anchor;
+	*op++ = ((lits >= 15) ? 15 : lits) << 4;
+	if (lits >= 15)
+		op = LZ4_WriteLength(op, lits - 15);
+	memcpy(op, src + anchor, lits);
+	op += lits;
+	
+	return op - dst;
+}
+
 int main(int argc, char *argv[])
 {
+	//Check for compression, the hash index and version 2
+	int compress = 0, index = 1, v2 = 0;
+	for (; argc >= 2 && argv[1][0] == '-'; argc--, argv++)
+	{
+		if (strcmp(argv[1], "-c") == 0)
+			compress = 1;
+		else if (strcmp(argv[1], "-n") == 0)
+			index = 0;
+		else if (strcmp(argv[1], "-2") == 0)
+			v2 = 1;
+		else
+			break;
+	}
+	
 	//Make sure the correct parameters have been given
 	if (argc < 3)
 	{
-		printf("usage: funkinarcpak out ...\n");
+		printf("usage: funkinarcpak [-c] [-n] [-2] out ...\n");
 		return 0;
 	}
 	
+	//Entries of version 2 archives are read on their own, so they're kept stored
+	if (v2 && compress)
+	{
+		printf("Not compressing %s, version 2 archives are read an entry at a time\n", argv[1]);
+		compress = 0;
+	}
+	
 	//Open output
 	FILE *out = fopen(argv[1], "wb");
 	if (out == NULL)
@@ -44,6 +181,7 @@ int main(int argc, char *argv[])
 	typedef struct
 	{
 		char name[12];
+		uint32_t hash;
 		uint32_t pos;
 		uint32_t size;
 		uint8_t *data;
@@ -87,51 +225,233 @@ int main(int argc, char *argv[])
 		fseek(in, 0, SEEK_SET);
 		fread(dirp->data, dirp->size, 1, in);
 		fclose(in);
+		
+		//Cut path
+		char *path = argv[i];
+		
+		char *cuts = path;
+		cuts += strlen(cuts);
+		while (cuts != (path - 1) && *cuts != '/' && *cuts != '\\') cuts--;
+		cuts++;
+		
+		//Get name
+		if (strlen(cuts) > 12)
+			printf("Asset %s name is longer than 12 characters and will be truncated\n", cuts);
+		strncpy(dirp->name, cuts, 12);
+		dirp->hash = Hash(dirp->name);
+	}
+	
+	//Build hash index, every name gets its own directory slot
+	size_t files = argc - 2;
+	uint16_t *disp = calloc(files, sizeof(uint16_t));
+	Pkg_Directory *order = calloc(files, sizeof(Pkg_Directory));
+	if (disp == NULL || order == NULL)
+	{
+		printf("Failed to allocate hash index\n");
+		return 1;
 	}
 	
-	//Set directory positions
+	for (size_t i = 0; index && i < files; i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			if (strncmp(dir[i].name, dir[j].name, 12) == 0)
+			{
+				printf("%.12s was given more than once, leaving out the hash index\n", dir[i].name);
+				index = 0;
+				break;
+			}
+		}
+	}
+	
+	if (index)
+	{
+		//Place buckets with the most names first, trying displacements until all their slots are free
+		char *used = calloc(files, 1);
+		size_t *bucket_size = calloc(files, sizeof(size_t));
+		if (used == NULL || bucket_size == NULL)
+		{
+			printf("Failed to allocate hash index\n");
+			return 1;
+		}
+		for (size_t i = 0; i < files; i++)
+			bucket_size[dir[i].hash % files]++;
+		
+		for (size_t placed = 0; index && placed < files;)
+		{
+			size_t bucket = 0;
+			for (size_t i = 1; i < files; i++)
+				if (bucket_size[i] > bucket_size[bucket])
+					bucket = i;
+			
+			uint32_t d;
+			for (d = 0; d <= ARC_DISP_MAX; d++)
+			{
+				//Check that every name lands on a free slot
+				size_t fits = 1;
+				for (size_t i = 0; fits && i < files; i++)
+				{
+					if (dir[i].hash % files != bucket)
+						continue;
+					uint32_t slot = Slot(dir[i].hash, d, files);
+					if (used[slot])
+						fits = 0;
+					used[slot] |= 2;
+				}
+				for (size_t i = 0; i < files; i++)
+					used[i] &= 1;
+				if (!fits)
+					continue;
+				
+				//Take the slots
+				for (size_t i = 0; i < files; i++)
+				{
+					if (dir[i].hash % files != bucket)
+						continue;
+					uint32_t slot = Slot(dir[i].hash, d, files);
+					used[slot] = 1;
+					order[slot] = dir[i];
+				}
+				break;
+			}
+			if (d > ARC_DISP_MAX)
+			{
+				printf("Couldn't place every name, leaving out the hash index\n");
+				index = 0;
+				break;
+			}
+			disp[bucket] = d;
+			placed += bucket_size[bucket];
+			bucket_size[bucket] = 0;
+		}
+		free(bucket_size);
+		free(used);
+		
+		//Directory is written in slot order
+		if (index)
+			memcpy(dir, order, sizeof(Pkg_Directory) * files);
+	}
+	free(order);
+	
+	//Set directory positions, the index sits between the directory and the first file
+	//Version 1 ends the directory with an empty entry and finds the index through a footer, version 2 has its header
+	uint32_t head_size = v2 ? ARC_V2_HEAD_SIZE : 0;
+	uint32_t ent_size = v2 ? ARC_V2_ENT_SIZE : 16;
+	uint32_t disp_pos = head_size + ent_size * files + (v2 ? 0 : 16);
+	uint32_t dir_size = index ? (((disp_pos + files * 2 + 0xF) & ~0xF) + (v2 ? 0 : 16)) : (head_size + ent_size * files);
+	uint32_t align = v2 ? (ARC_SECT_SIZE - 1) : 0xF;
+	
 	dirp = dir;
-	dirp->pos = 16 * (argc - 2);
+	dirp->pos = (dir_size + align) & ~align;
 	dirp++;
 	
 	for (int i = 3; i < argc; i++, dirp++)
-		dirp->pos = (dirp[-1].pos + dirp[-1].size + 0xF) & ~0xF;
+		dirp->pos = (dirp[-1].pos + dirp[-1].size + align) & ~align;
+	
+	//Write compressed archive header, the directory and positions describe the archive once expanded
+	if (compress)
+	{
+		fwrite("FARZ", 4, 1, out);
+		Write32(out, dir[argc - 3].pos + dir[argc - 3].size);
+		Write32(out, argc - 2);
+		Write32(out, index ? dir_size : 0);
+	}
+	
+	//Write version 2 header
+	if (v2)
+	{
+		fwrite(ARC_V2_MAGIC, 4, 1, out);
+		Write32(out, ARC_V2_VERSION);
+		Write32(out, files);
+		Write32(out, dir_size);
+		Write32(out, index ? disp_pos : 0);
+		Write32(out, index ? files : 0); //Buckets
+		Write32(out, 0);
+		Write32(out, 0);
+	}
 	
 	//Write directory
 	dirp = dir;
 	for (int i = 2; i < argc; i++, dirp++)
 	{
-		//Cut path
-		char *path = argv[i];
-		
-		char *cuts = path;
-		cuts += strlen(cuts);
-		while (cuts != (path - 1) && *cuts != '/' && *cuts != '\\') cuts--;
-		cuts++;
-		
-		//Write directory
-		if (strlen(cuts) > 12)
+		fwrite(dirp->name, 12, 1, out);
+		Write32(out, dirp->pos);
+		if (v2)
 		{
-			printf("Asset %s name is longer than 12 characters and will be truncated\n", cuts);
-			fwrite(cuts, 12, 1, out);
+			Write32(out, dirp->size);
+			Write32(out, ARC_FLAG_SECTOR);
+			Write32(out, 0);
+			Write32(out, 0);
 		}
-		else
-		{
-			fwrite(cuts, strlen(cuts), 1, out);
-			for (size_t j = strlen(cuts); j < 12; j++)
+	}
+	
+	//Write hash index, an empty entry ends a version 1 directory for readers that scan it
+	if (index)
+	{
+		if (!v2)
+			for (int i = 0; i < 16; i++)
 				fputc('\0', out);
+		for (size_t i = 0; i < files; i++)
+			Write16(out, disp[i]);
+		for (size_t i = disp_pos + files * 2; i < dir_size - (v2 ? 0 : 16); i++)
+			fputc('\0', out);
+		
+		if (!v2)
+		{
+			fwrite(ARC_INDEX_MAGIC, 4, 1, out);
+			Write32(out, files);
+			Write32(out, disp_pos);
+			Write32(out, files); //Buckets
 		}
-		Write32(out, dirp->pos);
 	}
+	free(disp);
 	
 	//Write file data
 	dirp = dir;
 	for (int i = 2; i < argc; i++, dirp++)
 	{
-		fseek(out, dirp->pos, SEEK_SET);
-		fwrite(dirp->data, dirp->size, 1, out);
+		if (compress)
+		{
+			//Compress entry, keeping it stored if that doesn't help
+			uint8_t *packed = malloc(dirp->size + dirp->size / 255 + 16);
+			if (packed == NULL)
+			{
+				printf("Failed to allocate compression buffer\n");
+				return 1;
+			}
+			size_t packed_size = LZ4_Compress(dirp->data, dirp->size, packed);
+			
+			Write32(out, dirp->size);
+			if (packed_size < dirp->size)
+			{
+				Write32(out, packed_size);
+				Write32(out, ARC_METHOD_LZ4);
+				fwrite(packed, packed_size, 1, out);
+			}
+			else
+			{
+				Write32(out, dirp->size);
+				Write32(out, ARC_METHOD_STORE);
+				fwrite(dirp->data, dirp->size, 1, out);
+			}
+			free(packed);
+		}
+		else
+		{
+			fseek(out, dirp->pos, SEEK_SET);
+			fwrite(dirp->data, dirp->size, 1, out);
+		}
 		free(dirp->data);
 	}
+	
+	//Pad version 2 archives to a whole sector
+	if (v2)
+	{
+		fseek(out, 0, SEEK_END);
+		while (ftell(out) % ARC_SECT_SIZE)
+			fputc('\0', out);
+	}
+	
 	free(dir);
 	fclose(out);
 	
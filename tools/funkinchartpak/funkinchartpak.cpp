@@ -13,6 +13,12 @@
 #include "json.hpp"
 using json = nlohmann::json;
 
+//Chart constants
+#define CHART_VERSION 2
+#define CHART_HEAD_SIZE 32
+
+#define NOTE_SCORE 35 //Max score of a hit note in game
+
 #define SECTION_FLAG_OPPFOCUS (1 << 15) //Focus on opponent
 #define SECTION_FLAG_BPM_MASK 0x7FFF //1/24
 
@@ -46,6 +52,12 @@ void WriteWord(std::ostream &out, uint16_t word)
 	out.put(word >> 8);
 }
 
+void WriteLong(std::ostream &out, uint32_t word)
+{
+	WriteWord(out, word >> 0);
+	WriteWord(out, word >> 16);
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc < 2)
@@ -160,6 +172,15 @@ int main(int argc, char *argv[])
 			return a.pos < b.pos;
 	});
 	
+	//Count max scores in game
+	int32_t max_score[2] = {0, 0};
+	for (auto &i : notes)
+	{
+		if (i.type & (NOTE_FLAG_SUSTAIN | NOTE_FLAG_MINE))
+			continue;
+		max_score[(i.type & NOTE_FLAG_OPPONENT) ? 1 : 0] += NOTE_SCORE;
+	}
+	
 	//Push dummy section and note
 	Section dum_section;
 	dum_section.end = 0xFFFF;
@@ -179,8 +200,20 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 	
+	//Write header, the game uses the rest of the file as is so every table is aligned
+	uint32_t section_pos = CHART_HEAD_SIZE;
+	uint32_t note_pos = section_pos + (sections.size() << 2);
+	
+	out.write("FCHT", 4);
+	WriteLong(out, CHART_VERSION);
+	WriteLong(out, sections.size() - 1);
+	WriteLong(out, notes.size() - 1);
+	WriteLong(out, section_pos);
+	WriteLong(out, note_pos);
+	WriteLong(out, max_score[0]);
+	WriteLong(out, max_score[1]);
+	
 	//Write sections
-	WriteWord(out, 2 + (sections.size() << 2));
 	for (auto &i : sections)
 	{
 		WriteWord(out, i.end);
@@ -0,0 +1,362 @@
+/*
+ * funkinpak
+ * Packs the ISO directory into a single indexed bundle for the Friday Night Funkin' PC port
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+//Bundle constants
+#define PAK_VERSION   1
+#define PAK_SECT_SIZE 2048
+
+#define PAK_METHOD_STORE 0
+#define PAK_METHOD_LZ4   1
+
+//LZ4 block compression, same as funkinarcpak
+#define LZ4_HASH_BITS 16
+#define LZ4_MFLIMIT   12 //Last match has to start this far from the end
+#define LZ4_LASTLITS  5  //And end this far from it
+
+void Write32(FILE *fp, uint32_t x)
+{
+	fputc(x, fp);
+	fputc(x >> 8, fp);
+	fputc(x >> 16, fp);
+	fputc(x >> 24, fp);
+}
+
+uint32_t Hash(const char *path)
+{
+	//FNV-1a of the upper case path, must match IO_PathHash
+	uint32_t hash = 0x811C9DC5;
+	for (; *path != '\0'; path++)
+	{
+		hash ^= (uint8_t)toupper((unsigned char)*path);
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+uint32_t Read32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint8_t *LZ4_WriteLength(uint8_t *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+size_t LZ4_Compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+	static uint32_t table[1 << LZ4_HASH_BITS];
+	memset(table, 0xFF, sizeof(table));
+	
+	uint8_t *op = dst;
+	size_t ip = 0, anchor = 0;
+	
+	if (size > LZ4_MFLIMIT)
+	{
+		while (ip < size - LZ4_MFLIMIT)
+		{
+			//Look up last position with the same 4 bytes
+			uint32_t seq = Read32(src + ip);
+			uint32_t hash = (seq * 2654435761U) >> (32 - LZ4_HASH_BITS);
+			uint32_t ref = table[hash];
+			table[hash] = ip;
+			
+			if (ref == 0xFFFFFFFF || ip - ref > 0xFFFF || Read32(src + ref) != seq)
+			{
+				ip++;
+				continue;
+			}
+			
+			//Extend match
+			size_t len = 4;
+			while (ip + len < size - LZ4_LASTLITS && src[ref + len] == src[ip + len])
+				len++;
+			
+			//Write literals and match
+			size_t lits = ip - anchor;
+			uint8_t *token = op++;
+			*token = ((lits >= 15) ? 15 : lits) << 4;
+			if (lits >= 15)
+				op = LZ4_WriteLength(op, lits - 15);
+			memcpy(op, src + anchor, lits);
+			op += lits;
+			
+			*op++ = (ip - ref);
+			*op++ = (ip - ref) >> 8;
+			
+			*token |= (len - 4 >= 15) ? 15 : (len - 4);
+			if (len - 4 >= 15)
+				op = LZ4_WriteLength(op, len - 4 - 15);
+			
+			ip += len;
+			anchor = ip;
+		}
+	}
+	
+	//Write last literals
+	size_t lits = size - anchor;
+	*op++ = ((lits >= 15) ? 15 : lits) << 4;
+	if (lits >= 15)
+		op = LZ4_WriteLength(op, lits - 15);
+	memcpy(op, src + anchor, lits);
+	op += lits;
+	
+	return op - dst;
+}
+
+int IsPartial(const uint8_t *data, uint32_t size)
+{
+	//Version 2 archives are read an entry at a time, which only works on stored files
+	return size >= 8 && memcmp(data, "FARC", 4) == 0 && Read32(data + 4) == 2;
+}
+
+int IsStreamed(const char *path)
+{
+	//Music is streamed with IO_OpenFile, which only opens loose files
+	size_t len = strlen(path);
+	return len >= 4 && strcasecmp(path + len - 4, ".mp3") == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	//Check for compression
+	int compress = 0;
+	for (; argc >= 2 && argv[1][0] == '-'; argc--, argv++)
+	{
+		if (strcmp(argv[1], "-c") == 0)
+			compress = 1;
+		else
+			break;
+	}
+	
+	//Make sure the correct parameters have been given
+	if (argc < 4)
+	{
+		printf("usage: funkinpak [-c] out.pak root ...\n");
+		return 0;
+	}
+	
+	//Allocate directory
+	typedef struct
+	{
+		char *name;
+		uint32_t hash;
+		uint32_t name_pos;
+		uint32_t pos;
+		uint32_t size;
+		uint32_t packed;
+		uint32_t method;
+		uint8_t *data;
+	} Pkg_Directory;
+	
+	//Leave out files that have to stay loose
+	const char **paths = malloc((argc - 3) * sizeof(const char*));
+	if (paths == NULL)
+	{
+		printf("Failed to allocate paths\n");
+		return 1;
+	}
+	
+	size_t files = 0;
+	for (int i = 3; i < argc; i++)
+	{
+		if (IsStreamed(argv[i]))
+		{
+			printf("Leaving out %s, music is read from loose files\n", argv[i]);
+			continue;
+		}
+		paths[files++] = argv[i];
+	}
+	if (files == 0)
+	{
+		printf("Nothing to bundle\n");
+		return 1;
+	}
+	
+	Pkg_Directory *dir = calloc(files, sizeof(Pkg_Directory));
+	if (dir == NULL)
+	{
+		printf("Failed to allocate directory\n");
+		return 1;
+	}
+	
+	//Get names relative to the root
+	const char *root = argv[2];
+	size_t root_len = strlen(root);
+	uint32_t names_size = 0;
+	
+	for (size_t i = 0; i < files; i++)
+	{
+		const char *path = paths[i];
+		if (strncmp(path, root, root_len) == 0)
+			path += root_len;
+		while (*path == '/' || *path == '\\')
+			path++;
+		
+		if ((dir[i].name = malloc(strlen(path) + 1)) == NULL)
+		{
+			printf("Failed to allocate name\n");
+			return 1;
+		}
+		char *namep = dir[i].name;
+		for (; *path != '\0'; path++)
+			*namep++ = (*path == '\\') ? '/' : *path;
+		*namep = '\0';
+		
+		dir[i].hash = Hash(dir[i].name);
+		dir[i].name_pos = names_size;
+		names_size += strlen(dir[i].name) + 1;
+	}
+	
+	//Build hash table at most half full
+	uint32_t slots = 1;
+	while (slots < files * 2)
+		slots <<= 1;
+	
+	Pkg_Directory **table = calloc(slots, sizeof(Pkg_Directory*));
+	if (table == NULL)
+	{
+		printf("Failed to allocate hash table\n");
+		return 1;
+	}
+	
+	for (size_t i = 0; i < files; i++)
+	{
+		uint32_t slot = dir[i].hash & (slots - 1);
+		for (; table[slot] != NULL; slot = (slot + 1) & (slots - 1))
+		{
+			if (table[slot]->hash == dir[i].hash && strcasecmp(table[slot]->name, dir[i].name) == 0)
+			{
+				printf("%s was given more than once\n", dir[i].name);
+				return 1;
+			}
+		}
+		table[slot] = &dir[i];
+	}
+	
+	//Read files and lay them out on sector boundaries after the directory
+	uint32_t names_pos = 16 + slots * 24;
+	uint32_t pos = (names_pos + names_size + PAK_SECT_SIZE - 1) / PAK_SECT_SIZE;
+	
+	for (size_t i = 0; i < files; i++)
+	{
+		//Open file
+		FILE *in = fopen(paths[i], "rb");
+		if (in == NULL)
+		{
+			printf("Failed to open %s\n", paths[i]);
+			return 1;
+		}
+		
+		//Read file
+		fseek(in, 0, SEEK_END);
+		dir[i].size = ftell(in);
+		dir[i].data = malloc(dir[i].size + 1);
+		if (dir[i].data == NULL)
+		{
+			printf("Failed to allocate file buffer\n");
+			fclose(in);
+			return 1;
+		}
+		fseek(in, 0, SEEK_SET);
+		fread(dir[i].data, dir[i].size, 1, in);
+		fclose(in);
+		
+		dir[i].packed = dir[i].size;
+		dir[i].method = PAK_METHOD_STORE;
+		if (compress && !IsPartial(dir[i].data, dir[i].size))
+		{
+			//Compress file, keeping it stored if that doesn't help
+			uint8_t *packed = malloc(dir[i].size + dir[i].size / 255 + 16);
+			if (packed == NULL)
+			{
+				printf("Failed to allocate compression buffer\n");
+				return 1;
+			}
+			size_t packed_size = LZ4_Compress(dir[i].data, dir[i].size, packed);
+			if (packed_size < dir[i].size)
+			{
+				free(dir[i].data);
+				dir[i].data = packed;
+				dir[i].packed = packed_size;
+				dir[i].method = PAK_METHOD_LZ4;
+			}
+			else
+			{
+				free(packed);
+			}
+		}
+		
+		dir[i].pos = pos;
+		pos += (dir[i].packed + PAK_SECT_SIZE - 1) / PAK_SECT_SIZE;
+	}
+	
+	//Open output
+	FILE *out = fopen(argv[1], "wb");
+	if (out == NULL)
+	{
+		printf("Failed to open %s\n", argv[1]);
+		return 1;
+	}
+	
+	//Write header
+	fwrite("FPAK", 4, 1, out);
+	Write32(out, PAK_VERSION);
+	Write32(out, slots);
+	Write32(out, names_size);
+	
+	//Write hash table
+	for (uint32_t i = 0; i < slots; i++)
+	{
+		Pkg_Directory *dirp = table[i];
+		if (dirp == NULL)
+		{
+			for (int j = 0; j < 6; j++)
+				Write32(out, 0);
+			continue;
+		}
+		Write32(out, dirp->hash);
+		Write32(out, names_pos + dirp->name_pos);
+		Write32(out, dirp->pos);
+		Write32(out, dirp->size);
+		Write32(out, dirp->packed);
+		Write32(out, dirp->method);
+	}
+	
+	//Write names
+	for (size_t i = 0; i < files; i++)
+		fwrite(dir[i].name, strlen(dir[i].name) + 1, 1, out);
+	
+	//Write file data
+	for (size_t i = 0; i < files; i++)
+	{
+		fseek(out, dir[i].pos * PAK_SECT_SIZE, SEEK_SET);
+		fwrite(dir[i].data, dir[i].packed, 1, out);
+		free(dir[i].data);
+		free(dir[i].name);
+	}
+	
+	//Pad last sector
+	fseek(out, 0, SEEK_END);
+	while (ftell(out) % PAK_SECT_SIZE)
+		fputc('\0', out);
+	
+	free(table);
+	free(dir);
+	free(paths);
+	fclose(out);
+	
+	return 0;
+}